@@ -0,0 +1,114 @@
+// Lays out the same text over and over, reading glyph metrics either from a
+// flat table indexed by codepoint, as Font does, or from a std::map keyed the
+// way sf::Font keys its glyphs, which is what layout used to go through.
+// Prints the glyphs per second of each. Build it in release.
+#include <SFML/Graphics/Glyph.hpp>
+#include <SFML/System/Vector2.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+constexpr int ITERATIONS = 20000;
+constexpr unsigned CHAR_SIZE = 48;
+
+struct PlacedGlyph {
+    const sf::Glyph *glyph;
+    sf::Vector2f position;
+};
+
+// Made up metrics, which only need to be different enough between glyphs
+// that nothing is folded away
+sf::Glyph makeGlyph(char32_t codepoint)
+{
+    sf::Glyph glyph;
+    glyph.advance = 20.0f + static_cast<float>(codepoint % 7);
+    if (codepoint > U' ') {
+        glyph.bounds = {1.0f, -30.0f, 18.0f, 30.0f};
+        glyph.textureRect = {static_cast<int>(codepoint) * 20, 0, 18, 30};
+    }
+    return glyph;
+}
+
+// sf::Font keeps a page of glyphs for each character size, and keys the
+// glyphs of a page on the outline thickness, boldness and codepoint
+std::uint64_t makeKey(char32_t codepoint, bool bold, float outline)
+{
+    std::uint32_t outlineBits = 0;
+    static_assert(sizeof(outlineBits) == sizeof(outline), "");
+    std::copy_n(reinterpret_cast<const char *>(&outline), sizeof(outline),
+                reinterpret_cast<char *>(&outlineBits));
+    return (static_cast<std::uint64_t>(outlineBits) << 32) |
+           (static_cast<std::uint64_t>(bold) << 31) | codepoint;
+}
+
+template <typename Lookup>
+double measure(const std::u32string &text, Lookup lookup)
+{
+    std::vector<PlacedGlyph> glyphs;
+    float checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; i++) {
+        glyphs.clear();
+        sf::Vector2f pos{0, static_cast<float>(CHAR_SIZE)};
+        for (auto character : text) {
+            if (character == U'\n') {
+                pos.y += CHAR_SIZE;
+                pos.x = 0;
+            }
+            const sf::Glyph &glyph = lookup(character);
+            if (glyph.bounds.width > 0 && glyph.bounds.height > 0) {
+                glyphs.push_back({&glyph, pos});
+            }
+            pos.x += glyph.advance;
+        }
+        checksum += pos.x + static_cast<float>(glyphs.size());
+    }
+    std::chrono::duration<double> seconds =
+        std::chrono::steady_clock::now() - start;
+
+    // Printed so the layout cannot be optimised out
+    std::cout << "  (checksum " << checksum << ")\n";
+    return static_cast<double>(text.size()) * ITERATIONS / seconds.count();
+}
+} // namespace
+
+int main()
+{
+    std::u32string text;
+    for (int line = 0; line < 8; line++) {
+        text += U"The quick brown fox jumps over the lazy dog 0123456789!?\n";
+    }
+
+    // The flat table, the same shape as the one Font builds from its char set
+    std::array<sf::Glyph, 128> table;
+    for (char32_t codepoint = 0; codepoint < table.size(); codepoint++) {
+        table[codepoint] = makeGlyph(codepoint);
+    }
+
+    std::map<unsigned, std::map<std::uint64_t, sf::Glyph>> pages;
+    for (char32_t codepoint = 0; codepoint < table.size(); codepoint++) {
+        pages[CHAR_SIZE][makeKey(codepoint, false, 0)] = makeGlyph(codepoint);
+    }
+
+    std::cout << "Flat table:\n";
+    double flat = measure(text, [&](char32_t codepoint) -> const sf::Glyph & {
+        return codepoint < table.size() ? table[codepoint] : table[0];
+    });
+    std::cout << "Map:\n";
+    double map = measure(text, [&](char32_t codepoint) -> const sf::Glyph & {
+        auto &page = pages[CHAR_SIZE];
+        auto itr = page.find(makeKey(codepoint, false, 0));
+        return itr != page.end() ? itr->second : page.begin()->second;
+    });
+
+    std::cout << "Flat table: " << flat / 1e6 << "M glyphs/s\n"
+              << "Map:        " << map / 1e6 << "M glyphs/s\n"
+              << "Speed up:   " << flat / map << "x\n";
+}
@@ -0,0 +1,30 @@
+#version 330
+
+layout (location = 0) in vec2 inVertexCoord;
+layout (location = 1) in vec2 inTextureCoord;
+
+// Which of the glyph buffer's transforms the vertex uses. It is the same for
+// every vertex of a text. The vertex only holds the low 16 bits, and the
+// draw id, which is set for each draw rather than read from a buffer, the rest
+layout (location = 2) in uint inTransformId;
+layout (location = 7) in uint inDrawId;
+
+layout (std140) uniform Camera {
+    mat4 projectionViewMatrix;
+};
+
+// Four texels per transform, one for each column of its model matrix
+uniform samplerBuffer transforms;
+
+out vec2 passTexCoord;
+
+void main() {
+    int column = int(inDrawId * 65536u + inTransformId) * 4;
+    mat4 modelMatrix = mat4(texelFetch(transforms, column),
+                            texelFetch(transforms, column + 1),
+                            texelFetch(transforms, column + 2),
+                            texelFetch(transforms, column + 3));
+    gl_Position = projectionViewMatrix * modelMatrix * vec4(inVertexCoord, 0.0, 1.0);
+
+    passTexCoord = inTextureCoord;
+}
\ No newline at end of file
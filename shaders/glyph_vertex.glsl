@@ -0,0 +1,30 @@
+#version 330
+
+// One instance per glyph, expanded from a shared unit quad
+layout (location = 0) in vec2 inCorner;
+layout (location = 1) in vec2 inPenPosition;
+layout (location = 2) in uint inGlyphId;
+
+uniform mat4 modelMatrix;
+
+layout (std140) uniform Camera {
+    mat4 projectionViewMatrix;
+};
+
+// Two texels per glyph: its bounds, then its rect in the atlas page in pixels
+uniform samplerBuffer glyphTable;
+uniform sampler2D text;
+
+out vec2 passTexCoord;
+
+void main() {
+    int row = int(inGlyphId) * 2;
+    vec4 bounds = texelFetch(glyphTable, row);
+    vec4 textureRect = texelFetch(glyphTable, row + 1);
+
+    vec2 position = inPenPosition + bounds.xy + inCorner * bounds.zw;
+    gl_Position = projectionViewMatrix * modelMatrix * vec4(position, 0.0, 1.0);
+
+    vec2 atlasSize = vec2(textureSize(text, 0));
+    passTexCoord = (textureRect.xy + inCorner * textureRect.zw) / atlasSize;
+}
\ No newline at end of file
@@ -0,0 +1,17 @@
+#version 330
+
+in vec2 passTexCoord;
+out vec4 outColour;
+uniform sampler2D text;
+
+float median(vec3 v) {
+    return max(min(v.r, v.g), min(max(v.r, v.g), v.b));
+}
+
+void main() {
+    // The edge of the glyph is where the median of the channels is 0.5
+    float distance = median(texture(text, passTexCoord).rgb);
+    float width = fwidth(distance) * 0.5;
+    float alpha = smoothstep(0.5 - width, 0.5 + width, distance);
+    outColour = vec4(1.0, 1.0, 1.0, alpha);
+}
\ No newline at end of file
@@ -0,0 +1,13 @@
+#version 330
+
+in vec2 passTexCoord;
+out vec4 outColour;
+uniform sampler2D text;
+
+void main() {
+    // The edge of the glyph is at 0.5, smooth it over about one screen pixel
+    float distance = texture(text, passTexCoord).a;
+    float width = fwidth(distance) * 0.5;
+    float alpha = smoothstep(0.5 - width, 0.5 + width, distance);
+    outColour = vec4(1.0, 1.0, 1.0, alpha);
+}
\ No newline at end of file
@@ -3,15 +3,25 @@
 layout (location = 0) in vec2 inVertexCoord;
 layout (location = 1) in vec2 inTextureCoord;
 
-uniform mat4 modelMatrix;
-uniform mat4 projectionViewMatrix;
+// The index of the draw in its draw list, which is not read from a buffer
+// but set before each draw
+layout (location = 7) in uint inDrawId;
+
+layout (std140) uniform Camera {
+    mat4 projectionViewMatrix;
+};
+
+// The model matrix of each draw in a draw list
+layout (std140) uniform Transforms {
+    mat4 modelMatrices[256];
+};
 
 out vec2 passTexCoord;
 out vec3 passFragPosition;
 
 void main() {
 	
-    gl_Position = projectionViewMatrix * modelMatrix * vec4(inVertexCoord, 0.0f, 1.0);
+    gl_Position = projectionViewMatrix * modelMatrices[inDrawId] * vec4(inVertexCoord, 0.0f, 1.0);
     
     passTexCoord = inTextureCoord;
 }
\ No newline at end of file
@@ -1,27 +1,63 @@
 #include "application.h"
 
 #include "gl/gl_errors.h"
+#include "gl/state_cache.h"
 
 #include <cmath>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
 
 #include "gl/primitive.h"
 #include "maths.h"
 
+namespace {
+// Where the "Camera" block of each shader reads from
+constexpr GLuint CAMERA_3D_BINDING = 1;
+constexpr GLuint CAMERA_2D_BINDING = 2;
+} // namespace
+
 Application::Application(sf::Window &window)
     : m_window(window)
 {
     glViewport(0, 0, 1600, 900);
-    glEnable(GL_DEPTH_TEST);
+    gl::setDepthTest(true);
    // glEnable(GL_CULL_FACE);
     //glCullFace(GL_BACK);
 
     m_quadShader.program.create("static", "static");
-    m_quadShader.program.bind();
-    m_quadShader.projViewLocation =
-        m_quadShader.program.getUniformLocation("projectionViewMatrix");
-    m_quadShader.modelLocation =
-        m_quadShader.program.getUniformLocation("modelMatrix");
+    m_quadShader.program.bindUniformBlock("Camera", CAMERA_3D_BINDING);
+    m_quadShader.program.bindUniformBlock("Transforms",
+                                          gl::DrawList::TRANSFORM_BINDING);
+
+    m_textShader.program.create("static", "msdf");
+    m_textShader.program.bindUniformBlock("Camera", CAMERA_2D_BINDING);
+    m_textShader.program.bindUniformBlock("Transforms",
+                                          gl::DrawList::TRANSFORM_BINDING);
+
+    m_labelShader.program.create("glyph_buffer", "msdf");
+    m_labelShader.program.bind();
+    gl::loadUniform(m_labelShader.program.getUniformLocation("transforms"),
+                    static_cast<GLint>(GlyphBuffer::TRANSFORM_UNIT));
+    m_labelShader.program.bindUniformBlock("Camera", CAMERA_2D_BINDING);
+
+    m_glyphShader.program.create("glyph", "msdf");
+    m_glyphShader.program.bind();
+    gl::loadUniform(m_glyphShader.program.getUniformLocation("glyphTable"),
+                    static_cast<GLint>(Text::GLYPH_TABLE_UNIT));
+    m_glyphShader.program.bindUniformBlock("Camera", CAMERA_2D_BINDING);
+    m_glyphShader.modelLocation =
+        m_glyphShader.program.getUniformLocation("modelMatrix");
+
+    // Each camera is bound from where it is in the buffer, which stays the
+    // same from frame to frame
+    std::size_t alignment = gl::getUniformBufferAlignment();
+    m_orthoCameraOffset =
+        (sizeof(glm::mat4) + alignment - 1) / alignment * alignment;
+    m_cameraBuffer.reserve(m_orthoCameraOffset + sizeof(glm::mat4));
+    m_cameraBuffer.bindRange(CAMERA_3D_BINDING, 0, sizeof(glm::mat4));
+    m_cameraBuffer.bindRange(CAMERA_2D_BINDING, m_orthoCameraOffset,
+                             sizeof(glm::mat4));
 
     m_quad = makeQuadVertexArray(1.0f, 1.0f);
 
@@ -33,10 +69,37 @@ Application::Application(sf::Window &window)
 
 
     m_text.setPosition({200, 500, 0});
-    m_font.init("res/Montserrat-Bold.ttf", 256);
+    // Loaded in the background, the text appears once it is ready
+    m_font = m_fontCache.getAsync("res/Montserrat-Bold.ttf", 48,
+                                  FontType::MultiChannelSignedDistanceField);
     m_text.setCharSize(32.f);
-    m_text.setFont(m_font);
+    m_text.setFont(*m_font);
+    m_text.setInstanced(true);
     m_text.setText("Hello world\n");
+
+    m_clockText.setPosition({200, 400, 0});
+    m_clockText.setCharSize(24.f);
+    m_clockText.setFont(*m_font);
+    m_textStream.create(1024 * 1024);
+    m_clockText.setStreamBuffer(&m_textStream);
+
+    m_glyphBuffer.create(16 * 1024);
+    createLabels(1000);
+}
+
+void Application::createLabels(std::size_t count)
+{
+    m_labels.clear();
+    m_labels.resize(count);
+    for (std::size_t i = 0; i < count; i++) {
+        auto &label = m_labels[i];
+        label.setFont(*m_font);
+        label.setCharSize(12.f);
+        label.setPosition({static_cast<float>(i % 20) * 80.0f,
+                           static_cast<float>(i / 20 % 45) * 20.0f, 0});
+        label.setText("Label " + std::to_string(i));
+        label.setGlyphBuffer(&m_glyphBuffer);
+    }
 }
 
 void Application::run()
@@ -79,6 +142,28 @@ void Application::onEvent(sf::Event e)
                     m_isMouseLocked = !m_isMouseLocked;
                     break;
 
+                // Steps the number of labels between 1k, 10k and 100k
+                case sf::Keyboard::Up:
+                    createLabels(std::min<std::size_t>(m_labels.size() * 10,
+                                                       100000));
+                    break;
+
+                case sf::Keyboard::Down:
+                    createLabels(std::max<std::size_t>(m_labels.size() / 10,
+                                                       1000));
+                    break;
+
+                case sf::Keyboard::B:
+                    m_isBatchingLabels = !m_isBatchingLabels;
+                    break;
+
+                // Cycles through the ways of checking for errors, to compare
+                // what each costs
+                case sf::Keyboard::E:
+                    gl::setErrorPolicy(static_cast<gl::ErrorPolicy>(
+                        (static_cast<int>(gl::getErrorPolicy()) + 1) % 4));
+                    break;
+
                 default:
                     break;
             }
@@ -121,16 +206,65 @@ void Application::onInput()
 
 void Application::onUpdate()
 {
+    m_font->update();
+
+    // Changes every frame, and shows what changing it costs
+    std::size_t createdObjects = gl::getCreatedObjectCount();
+    std::size_t drawCalls = gl::getDrawCallCount();
+    std::size_t issuedChanges = gl::getIssuedStateChangeCount();
+    std::size_t skippedChanges = gl::getSkippedStateChangeCount();
+    std::size_t uniformUploads = gl::getUniformUploadCount();
+    std::size_t uniformBufferUploads = gl::getUniformBufferUploadCount();
+    std::ostringstream clock;
+    clock << std::fixed << std::setprecision(2)
+          << m_clock.getElapsedTime().asSeconds() << "s\n"
+          << "Frame: " << m_frameClock.restart().asSeconds() * 1000.0f
+          << "ms\n"
+          << "GL objects made last frame: " << createdObjects - m_createdObjects
+          << "\nDraw calls last frame: " << drawCalls - m_drawCalls << " ("
+          << m_textDraws.getBucketCount() + m_labelDraws.getBucketCount()
+          << " text groups)"
+          << "\nState changes last frame: "
+          << issuedChanges - m_issuedStateChanges << " made, "
+          << skippedChanges - m_skippedStateChanges << " skipped"
+          << "\nUniform uploads last frame: "
+          << uniformUploads - m_uniformUploads << ", and "
+          << uniformBufferUploads - m_uniformBufferUploads
+          << " to uniform buffers"
+          << "\nLabels: " << m_labels.size()
+          << (m_isBatchingLabels ? " in a batch" : " one by one")
+          << "\nGlyph buffer: " << m_glyphBuffer.getLiveBytes() / 1024
+          << "KiB live, " << m_glyphBuffer.getFragmentation() * 100.0f
+          << "% fragmented"
+          << "\nLayout: " << m_clockText.getLayoutTime().count() << "us"
+          << "\nGL errors: " << gl::getErrorCount() << ", checked with "
+          << gl::getErrorPolicyName(gl::getErrorPolicy()) << " (E to change)";
+    m_createdObjects = createdObjects;
+    m_drawCalls = drawCalls;
+    m_issuedStateChanges = issuedChanges;
+    m_skippedStateChanges = skippedChanges;
+    m_uniformUploads = uniformUploads;
+    m_uniformBufferUploads = uniformBufferUploads;
+    m_clockText.setText(clock.str());
 }
 
 void Application::onRender()
 {
+    // Before any text writes into it this frame
+    m_textStream.beginFrame();
+
     glm::mat4 projectionViewMatrix =
         createProjectionViewMatrix(player.pos, player.rot, m_projectionMatrix);
     
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);  
+    gl::setBlending(true);
+    gl::setBlendFunction(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
+    // Both cameras go up in one upload, which every shader then reads from
+    m_cameraData.clear();
+    m_cameraData.write(projectionViewMatrix);
+    m_cameraData.alignTo(m_orthoCameraOffset);
+    m_cameraData.write(m_orthoMatrix);
+    m_cameraBuffer.update(m_cameraData.getData(), m_cameraData.getBytes());
 
     // Render the quad
     m_quadShader.program.bind();
@@ -138,14 +272,30 @@ void Application::onRender()
     rotateMatrix(modelMatrix, {0.0f, 0.0f, 0.f});
     scaleMatrix(modelMatrix, {2.0f});
 
-    gl::loadUniform(m_quadShader.projViewLocation, projectionViewMatrix);
-    gl::loadUniform(m_quadShader.modelLocation, modelMatrix);
-
-    m_texture.bind();
-    m_quad.bind();
-    m_quad.getDrawable().bindAndDraw();
+    m_quadDraws.add(m_quad.getDrawable(), modelMatrix, &m_texture);
+    m_quadDraws.submit();
 
     //Render text
-    gl::loadUniform(m_quadShader.projViewLocation, m_orthoMatrix);
-    m_text.render(m_quadShader.modelLocation);
+    m_glyphShader.program.bind();
+    m_text.render(m_glyphShader.modelLocation);
+
+    m_textShader.program.bind();
+    m_clockText.addTo(m_textDraws);
+    for (auto &label : m_labels) {
+        if (m_isBatchingLabels) {
+            m_labelBatch.add(label);
+        }
+        else {
+            label.addTo(m_labelDraws);
+        }
+    }
+    if (m_isBatchingLabels) {
+        m_labelBatch.addTo(m_textDraws);
+    }
+    m_textDraws.submit();
+
+    // Labels are grouped only by atlas page, as each finds its own matrix
+    m_labelShader.program.bind();
+    m_glyphBuffer.bindTransforms();
+    m_labelDraws.submit();
 }
\ No newline at end of file
@@ -1,18 +1,23 @@
 #pragma once
 
+#include <SFML/System/Clock.hpp>
 #include <SFML/Window/Window.hpp>
 #include <iostream>
 #include <vector>
 
+#include "gl/draw_list.h"
 #include "gl/primitive.h"
 #include "gl/shader.h"
+#include "gl/stream_buffer.h"
 #include "gl/textures.h"
 #include "gl/vertex_array.h"
 
 #include <SFML/Graphics/Font.hpp>
 
+#include "font_cache.h"
 #include "input/keyboard.h"
 #include "text.h"
+#include "text_batch.h"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -33,15 +38,30 @@ class Application {
     void onInput();
     void onUpdate();
     void onRender();
+    void createLabels(std::size_t count);
 
     sf::Window &m_window;
 
+    // The camera and transforms of these come from uniform buffers
     struct {
         gl::Shader program;
-        gl::UniformLocation projViewLocation;
-        gl::UniformLocation modelLocation;
     } m_quadShader;
 
+    struct {
+        gl::Shader program;
+    } m_textShader;
+
+    // For text in a glyph buffer, which keeps the transforms itself
+    struct {
+        gl::Shader program;
+    } m_labelShader;
+
+    // For text drawn as instances
+    struct {
+        gl::Shader program;
+        gl::UniformLocation modelLocation;
+    } m_glyphShader;
+
     struct {
         glm::vec3 pos{0.0, 0.0, 2.0f}, rot;
     } player;
@@ -49,13 +69,41 @@ class Application {
     glm::mat4 m_projectionMatrix{1.0f};
     glm::mat4 m_orthoMatrix{1.0f};
 
+    // The 3D and the 2D camera, one after the other, shared by every shader
+    gl::UniformBuffer m_cameraBuffer;
+    gl::Std140Writer m_cameraData;
+    std::size_t m_orthoCameraOffset = 0;
+
     gl::VertexArray m_quad;
     gl::Texture2d m_texture;
 
+    // Draws collected over a frame, one list for each shader
+    gl::DrawList m_quadDraws;
+    gl::DrawList m_textDraws;
+    gl::DrawList m_labelDraws;
+
     Keyboard m_keyboard;
 
-    Font m_font;
+    FontCache m_fontCache;
+    std::shared_ptr<Font> m_font;
+    gl::StreamBuffer m_textStream;
     Text m_text;
+    Text m_clockText;
+    sf::Clock m_clock;
+    sf::Clock m_frameClock;
+    std::size_t m_createdObjects = 0;
+    std::size_t m_drawCalls = 0;
+    std::size_t m_issuedStateChanges = 0;
+    std::size_t m_skippedStateChanges = 0;
+    std::size_t m_uniformUploads = 0;
+    std::size_t m_uniformBufferUploads = 0;
+
+    // Lots of small labels, to test the cost of many texts. They are either
+    // drawn in one batch, or one by one from a shared glyph buffer
+    GlyphBuffer m_glyphBuffer;
+    TextBatch m_labelBatch;
+    std::vector<Text> m_labels;
+    bool m_isBatchingLabels = true;
 
     bool m_isMouseLocked = false;
 };
\ No newline at end of file
@@ -0,0 +1,150 @@
+#include "atlas_packer.h"
+
+#include <algorithm>
+#include <limits>
+
+void SkylinePacker::reset(unsigned width, unsigned height)
+{
+    m_width = width;
+    m_height = height;
+    m_usedArea = 0;
+    m_skyline.clear();
+    m_skyline.push_back({0, 0, width});
+}
+
+bool SkylinePacker::pack(unsigned width, unsigned height,
+                         sf::Vector2u &position)
+{
+    // Place the rectangle where its bottom would be the lowest, preferring
+    // the narrowest segment to keep the skyline even
+    constexpr unsigned NONE = std::numeric_limits<unsigned>::max();
+    unsigned bestBottom = NONE;
+    unsigned bestWidth = NONE;
+    std::size_t bestIndex = 0;
+    unsigned bestY = 0;
+    for (std::size_t i = 0; i < m_skyline.size(); i++) {
+        unsigned y = 0;
+        if (!findY(i, width, height, y)) {
+            continue;
+        }
+        unsigned bottom = y + height;
+        if (bottom < bestBottom ||
+            (bottom == bestBottom && m_skyline[i].width < bestWidth)) {
+            bestBottom = bottom;
+            bestWidth = m_skyline[i].width;
+            bestIndex = i;
+            bestY = y;
+        }
+    }
+    if (bestBottom == NONE) {
+        return false;
+    }
+
+    position = {m_skyline[bestIndex].x, bestY};
+    Segment segment{position.x, bestY + height, width};
+    m_skyline.insert(m_skyline.begin() + bestIndex, segment);
+
+    // Cut the segments that are now under the new one
+    unsigned right = segment.x + segment.width;
+    for (std::size_t i = bestIndex + 1; i < m_skyline.size();) {
+        Segment &next = m_skyline[i];
+        if (next.x >= right) {
+            break;
+        }
+        unsigned overlap = right - next.x;
+        if (overlap >= next.width) {
+            m_skyline.erase(m_skyline.begin() + i);
+            continue;
+        }
+        next.x += overlap;
+        next.width -= overlap;
+        break;
+    }
+
+    merge();
+    m_usedArea += static_cast<std::size_t>(width) * height;
+    return true;
+}
+
+void SkylinePacker::grow(unsigned width, unsigned height)
+{
+    if (width > m_width) {
+        m_skyline.push_back({m_width, 0, width - m_width});
+        m_width = width;
+    }
+    m_height = std::max(m_height, height);
+}
+
+void SkylinePacker::reserve(unsigned x, unsigned y, unsigned width,
+                            unsigned height)
+{
+    unsigned right = std::min(x + width, m_width);
+    if (width == 0 || height == 0 || x >= right) {
+        return;
+    }
+    split(x);
+    split(right);
+    for (auto &segment : m_skyline) {
+        if (segment.x >= x && segment.x < right) {
+            segment.y = std::max(segment.y, y + height);
+        }
+    }
+    merge();
+    m_usedArea += static_cast<std::size_t>(right - x) * height;
+}
+
+float SkylinePacker::getFillRatio() const
+{
+    if (m_width == 0 || m_height == 0) {
+        return 0;
+    }
+    return static_cast<float>(m_usedArea) /
+           (static_cast<float>(m_width) * static_cast<float>(m_height));
+}
+
+bool SkylinePacker::findY(std::size_t index, unsigned width, unsigned height,
+                          unsigned &y) const
+{
+    if (m_skyline[index].x + width > m_width) {
+        return false;
+    }
+    // The rectangle rests on the highest segment underneath it
+    y = 0;
+    unsigned covered = 0;
+    for (std::size_t i = index; covered < width; i++) {
+        y = std::max(y, m_skyline[i].y);
+        if (y + height > m_height) {
+            return false;
+        }
+        covered += m_skyline[i].width;
+    }
+    return true;
+}
+
+void SkylinePacker::split(unsigned x)
+{
+    // Makes sure a segment starts at x
+    for (std::size_t i = 0; i < m_skyline.size(); i++) {
+        Segment &segment = m_skyline[i];
+        if (x > segment.x && x < segment.x + segment.width) {
+            Segment right{x, segment.y, segment.x + segment.width - x};
+            segment.width = x - segment.x;
+            m_skyline.insert(m_skyline.begin() + i + 1, right);
+            return;
+        }
+    }
+}
+
+void SkylinePacker::merge()
+{
+    // Joins up neighbours at the same height
+    for (std::size_t i = 0; i + 1 < m_skyline.size();) {
+        if (m_skyline[i].y == m_skyline[i + 1].y) {
+            m_skyline[i].width += m_skyline[i + 1].width;
+            m_skyline.erase(m_skyline.begin() + i + 1);
+        }
+        else {
+            i++;
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <SFML/System/Vector2.hpp>
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief Places rectangles into a fixed size area using the skyline
+ * bottom-left heuristic. Rectangles are never moved once placed, so new ones
+ * can be added at any time without repacking
+ */
+class SkylinePacker final {
+  public:
+    void reset(unsigned width, unsigned height);
+
+    /**
+     * @brief Finds space for a rectangle
+     *
+     * @param width The width of the rectangle
+     * @param height The height of the rectangle
+     * @param position Set to the top left of the rectangle
+     * @return true The rectangle was placed
+     * @return false There is no space left for the rectangle
+     */
+    bool pack(unsigned width, unsigned height, sf::Vector2u &position);
+
+    /**
+     * @brief Grows the packing area, keeping all of the placed rectangles
+     * where they are
+     */
+    void grow(unsigned width, unsigned height);
+
+    /**
+     * @brief Marks an area as used, by raising the skyline over it. Used to
+     * rebuild the packer for a layout that was made somewhere else
+     */
+    void reserve(unsigned x, unsigned y, unsigned width, unsigned height);
+
+    /**
+     * @brief How much of the packing area is covered by rectangles
+     *
+     * @return float The covered area, between 0 and 1
+     */
+    float getFillRatio() const;
+
+  private:
+    // The lowest free y of a horizontal span of the area
+    struct Segment {
+        unsigned x = 0;
+        unsigned y = 0;
+        unsigned width = 0;
+    };
+
+    bool findY(std::size_t index, unsigned width, unsigned height,
+               unsigned &y) const;
+    void split(unsigned x);
+    void merge();
+
+    std::vector<Segment> m_skyline;
+    unsigned m_width = 0;
+    unsigned m_height = 0;
+    std::size_t m_usedArea = 0;
+};
@@ -0,0 +1,179 @@
+#include "baked_atlas.h"
+
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+// Bump whenever the layout of the file, or how atlases are made, changes
+constexpr std::uint32_t BAKED_ATLAS_VERSION = 3;
+constexpr char BAKED_ATLAS_MAGIC[4] = {'G', 'L', 'T', 'A'};
+
+/**
+ * @brief The start of a cache file. It is followed by the glyphs, then the
+ * kerning table and then the atlas pixels
+ */
+struct BakedAtlasHeader {
+    char magic[4];
+    std::uint32_t version;
+    BakedAtlasKey key;
+
+    std::uint32_t glyphCount;
+    std::uint32_t kerningCount;
+    std::uint32_t imageSize;
+    std::uint32_t channels;
+    float lineHeight;
+    std::uint32_t padding;
+};
+
+namespace {
+std::size_t glyphsOffset()
+{
+    return sizeof(BakedAtlasHeader);
+}
+
+std::size_t kerningOffset(const BakedAtlasHeader &header)
+{
+    return glyphsOffset() + header.glyphCount * sizeof(BakedGlyph);
+}
+
+std::size_t pixelsOffset(const BakedAtlasHeader &header)
+{
+    return kerningOffset(header) + header.kerningCount * sizeof(float);
+}
+
+std::size_t fileSize(const BakedAtlasHeader &header)
+{
+    return pixelsOffset(header) + static_cast<std::size_t>(header.imageSize) *
+                                      header.imageSize * header.channels;
+}
+
+bool operator==(const BakedAtlasKey &a, const BakedAtlasKey &b)
+{
+    return a.fontHash == b.fontHash && a.charSetHash == b.charSetHash &&
+           a.bitmapScale == b.bitmapScale && a.fontType == b.fontType;
+}
+} // namespace
+
+bool BakedAtlasFile::open(const std::string &path, const BakedAtlasKey &key)
+{
+    m_header = nullptr;
+    if (!m_file.open(path)) {
+        return false;
+    }
+    if (m_file.getSize() < sizeof(BakedAtlasHeader)) {
+        m_file.close();
+        return false;
+    }
+
+    auto header = reinterpret_cast<const BakedAtlasHeader *>(m_file.getData());
+    if (std::memcmp(header->magic, BAKED_ATLAS_MAGIC, 4) != 0 ||
+        header->version != BAKED_ATLAS_VERSION || !(header->key == key) ||
+        m_file.getSize() != fileSize(*header)) {
+        m_file.close();
+        return false;
+    }
+    m_header = header;
+    return true;
+}
+
+const BakedGlyph *BakedAtlasFile::getGlyphs() const
+{
+    return reinterpret_cast<const BakedGlyph *>(m_file.getData() +
+                                                glyphsOffset());
+}
+
+std::size_t BakedAtlasFile::getGlyphCount() const
+{
+    return m_header->glyphCount;
+}
+
+const float *BakedAtlasFile::getKerning() const
+{
+    return reinterpret_cast<const float *>(m_file.getData() +
+                                           kerningOffset(*m_header));
+}
+
+std::size_t BakedAtlasFile::getKerningCount() const
+{
+    return m_header->kerningCount;
+}
+
+const std::uint8_t *BakedAtlasFile::getPixels() const
+{
+    return m_file.getData() + pixelsOffset(*m_header);
+}
+
+unsigned BakedAtlasFile::getImageSize() const
+{
+    return m_header->imageSize;
+}
+
+unsigned BakedAtlasFile::getChannels() const
+{
+    return m_header->channels;
+}
+
+float BakedAtlasFile::getLineHeight() const
+{
+    return m_header->lineHeight;
+}
+
+bool saveBakedAtlas(const std::string &path, const BakedAtlasKey &key,
+                    const BakedAtlas &atlas)
+{
+    BakedAtlasHeader header;
+    std::memcpy(header.magic, BAKED_ATLAS_MAGIC, 4);
+    header.version = BAKED_ATLAS_VERSION;
+    header.key = key;
+    header.glyphCount = atlas.glyphs.size();
+    header.kerningCount = atlas.kerning.size();
+    header.imageSize = atlas.imageSize;
+    header.channels = atlas.channels;
+    header.lineHeight = atlas.lineHeight;
+    header.padding = 0;
+
+    std::error_code error;
+    std::filesystem::create_directories(
+        std::filesystem::path(path).parent_path(), error);
+
+    // Write to a temporary file first, so that a crash part way through can
+    // never leave behind a cache file that looks valid. The name is unique,
+    // so other processes or threads saving the same atlas do not write into
+    // the same file
+    static std::atomic<unsigned> saveCount{0};
+    std::string tempPath = path + "." +
+                           std::to_string(std::random_device{}()) + "." +
+                           std::to_string(saveCount++) + ".tmp";
+    {
+        std::ofstream outFile(tempPath, std::ios::binary);
+        if (!outFile.is_open()) {
+            std::cerr << "Could not write: " << path << '\n';
+            std::filesystem::remove(tempPath, error);
+            return false;
+        }
+        outFile.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        outFile.write(reinterpret_cast<const char *>(atlas.glyphs.data()),
+                      atlas.glyphs.size() * sizeof(BakedGlyph));
+        outFile.write(reinterpret_cast<const char *>(atlas.kerning.data()),
+                      atlas.kerning.size() * sizeof(float));
+        outFile.write(reinterpret_cast<const char *>(atlas.pixels),
+                      fileSize(header) - pixelsOffset(header));
+        outFile.close();
+        if (!outFile) {
+            std::cerr << "Could not write: " << path << '\n';
+            std::filesystem::remove(tempPath, error);
+            return false;
+        }
+    }
+    std::filesystem::rename(tempPath, path, error);
+    if (error) {
+        std::cerr << "Could not write: " << path << " (" << error.message()
+                  << ")\n";
+        std::filesystem::remove(tempPath, error);
+        return false;
+    }
+    return true;
+}
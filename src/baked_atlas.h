@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+
+struct BakedAtlasHeader;
+
+/**
+ * @brief Everything that changes the contents of a baked atlas. A cache file
+ * is only used when all of these match
+ */
+struct BakedAtlasKey {
+    std::uint64_t fontHash = 0;
+    std::uint64_t charSetHash = 0;
+    std::uint32_t bitmapScale = 0;
+    std::uint32_t fontType = 0;
+};
+
+/**
+ * @brief The metrics of a single glyph, as stored in a cache file
+ */
+struct BakedGlyph {
+    std::uint32_t codepoint = 0;
+    float advance = 0;
+    float bounds[4] = {};
+    std::int32_t textureRect[4] = {};
+};
+
+/**
+ * @brief The contents of a baked atlas, used for writing a cache file
+ */
+struct BakedAtlas {
+    std::vector<BakedGlyph> glyphs;
+    std::vector<float> kerning;
+    float lineHeight = 0;
+
+    const std::uint8_t *pixels = nullptr;
+    std::uint32_t imageSize = 0;
+    std::uint32_t channels = 0;
+};
+
+/**
+ * @brief A baked atlas cache file, memory mapped so that its pixels and
+ * metrics can be used in place
+ */
+class BakedAtlasFile final {
+  public:
+    /**
+     * @brief Maps a cache file, checking it was made by this version and
+     * with the same key
+     *
+     * @param path The cache file to open
+     * @param key The key the cache file must match
+     * @return true The file is usable
+     * @return false The file is missing, corrupt or out of date
+     */
+    bool open(const std::string &path, const BakedAtlasKey &key);
+
+    const BakedGlyph *getGlyphs() const;
+    std::size_t getGlyphCount() const;
+
+    const float *getKerning() const;
+    std::size_t getKerningCount() const;
+
+    const std::uint8_t *getPixels() const;
+    unsigned getImageSize() const;
+    unsigned getChannels() const;
+
+    float getLineHeight() const;
+
+  private:
+    MappedFile m_file;
+    const BakedAtlasHeader *m_header = nullptr;
+};
+
+/**
+ * @brief Writes a baked atlas to a cache file
+ *
+ * @param path The cache file to write, its directory is created if needed
+ * @param key The key the atlas was made with
+ * @param atlas The atlas to write
+ * @return true The file was written
+ * @return false The file could not be written
+ */
+bool saveBakedAtlas(const std::string &path, const BakedAtlasKey &key,
+                    const BakedAtlas &atlas);
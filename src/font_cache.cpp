@@ -0,0 +1,81 @@
+#include "font_cache.h"
+
+#include <filesystem>
+
+namespace {
+std::string normalisePath(const std::string &path)
+{
+    // Different spellings of the same path should still find the same font
+    return std::filesystem::path(path).lexically_normal().string();
+}
+} // namespace
+
+std::shared_ptr<Font> FontCache::get(const std::string &fontFile,
+                                     unsigned bitmapScale, FontType type)
+{
+    Key key{normalisePath(fontFile), bitmapScale, type};
+    if (auto font = find(key)) {
+        // It may have been asked for with getAsync first, but this caller
+        // expects it to be ready
+        font->waitUntilLoaded();
+        return font;
+    }
+    auto font = std::make_shared<Font>();
+    font->init(fontFile, bitmapScale, type);
+    m_fonts[key] = font;
+    return font;
+}
+
+std::shared_ptr<Font> FontCache::getAsync(const std::string &fontFile,
+                                          unsigned bitmapScale, FontType type)
+{
+    Key key{normalisePath(fontFile), bitmapScale, type};
+    if (auto font = find(key)) {
+        return font;
+    }
+    auto font = std::make_shared<Font>();
+    font->initAsync(fontFile, bitmapScale, type);
+    m_fonts[key] = font;
+    return font;
+}
+
+std::shared_ptr<Font> FontCache::find(const Key &key)
+{
+    removeExpired();
+    auto itr = m_fonts.find(key);
+    return itr != m_fonts.end() ? itr->second.lock() : nullptr;
+}
+
+std::size_t FontCache::getFontCount() const
+{
+    std::size_t count = 0;
+    for (auto &entry : m_fonts) {
+        if (!entry.second.expired()) {
+            count++;
+        }
+    }
+    return count;
+}
+
+std::size_t FontCache::getTotalAtlasBytes() const
+{
+    std::size_t bytes = 0;
+    for (auto &entry : m_fonts) {
+        if (auto font = entry.second.lock()) {
+            bytes += font->getTextureAtlasBytes();
+        }
+    }
+    return bytes;
+}
+
+void FontCache::removeExpired()
+{
+    for (auto itr = m_fonts.begin(); itr != m_fonts.end();) {
+        if (itr->second.expired()) {
+            itr = m_fonts.erase(itr);
+        }
+        else {
+            itr++;
+        }
+    }
+}
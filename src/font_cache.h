@@ -0,0 +1,51 @@
+#pragma once
+
+#include "text.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+
+/**
+ * @brief Hands out shared fonts, so that asking for the same font twice
+ * never loads or rasterizes it again. A font is freed once the last handle to
+ * it is dropped
+ */
+class FontCache final {
+  public:
+    /**
+     * @brief Gets a font, loading it if nothing else is holding it. A font
+     * that is still loading in the background is waited for
+     *
+     * @param fontFile The font file to load
+     * @param bitmapScale The size the glyphs are rasterized at
+     * @param type How the glyphs are stored in the atlas
+     * @return std::shared_ptr<Font> The shared font
+     */
+    std::shared_ptr<Font> get(const std::string &fontFile,
+                              unsigned bitmapScale,
+                              FontType type = FontType::Bitmap);
+
+    /**
+     * @brief Same as get(), but a font that is not held yet is loaded on a
+     * worker thread. See Font::initAsync
+     */
+    std::shared_ptr<Font> getAsync(const std::string &fontFile,
+                                   unsigned bitmapScale,
+                                   FontType type = FontType::Bitmap);
+
+    // Number of fonts that are still held by something
+    std::size_t getFontCount() const;
+
+    // Texture memory used by the atlases of every font that is still held
+    std::size_t getTotalAtlasBytes() const;
+
+  private:
+    using Key = std::tuple<std::string, unsigned, FontType>;
+
+    std::shared_ptr<Font> find(const Key &key);
+    void removeExpired();
+
+    std::map<Key, std::weak_ptr<Font>> m_fonts;
+};
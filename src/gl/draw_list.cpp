@@ -0,0 +1,225 @@
+#include "draw_list.h"
+#include "gl_errors.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <tuple>
+
+namespace gl {
+namespace {
+bool isSameMatrix(const glm::mat4 &a, const glm::mat4 &b)
+{
+    return std::memcmp(&a, &b, sizeof(glm::mat4)) == 0;
+}
+} // namespace
+
+DrawList::~DrawList()
+{
+    if (m_indirectBuffer) {
+        glCheck(glDeleteBuffers(1, &m_indirectBuffer));
+    }
+}
+
+bool DrawList::isSameState(const State &a, const State &b)
+{
+    return a.vao == b.vao && a.indexType == b.indexType &&
+           a.drawMode == b.drawMode && a.texture == b.texture &&
+           a.hasModelMatrix == b.hasModelMatrix &&
+           (a.hasModelMatrix ? isSameMatrix(a.modelMatrix, b.modelMatrix)
+                             : a.drawId == b.drawId);
+}
+
+void DrawList::add(const Drawable &drawable, const DrawCommand &command,
+                   const glm::mat4 &modelMatrix, const Texture2d *texture,
+                   GLenum drawMode)
+{
+    if (command.count == 0) {
+        return;
+    }
+    State state{drawable.getHandle(), drawable.getIndexType(), drawMode,
+                texture, true, modelMatrix, 0};
+    m_entries.push_back({state, command, nullptr});
+}
+
+void DrawList::add(const Drawable &drawable, const glm::mat4 &modelMatrix,
+                   const Texture2d *texture, GLenum drawMode)
+{
+    add(drawable, {drawable.getIndicesCount(), 0, 0}, modelMatrix, texture,
+        drawMode);
+}
+
+void DrawList::add(const DrawSource &source, const DrawCommand &command,
+                   const Texture2d *texture, GLenum drawMode)
+{
+    if (command.count == 0) {
+        return;
+    }
+    // The vertex array is filled in by submit
+    State state{0, GL_UNSIGNED_INT, drawMode, texture, false,
+                glm::mat4{1.0f}, 0};
+    m_entries.push_back({state, command, &source});
+}
+
+void DrawList::submit()
+{
+    // Sources can have been moved, or had their index type widened, by draws
+    // added after them
+    for (auto &entry : m_entries) {
+        if (entry.source) {
+            Drawable drawable = entry.source->getDrawable();
+            entry.state.vao = drawable.getHandle();
+            entry.state.indexType = drawable.getIndexType();
+            entry.command.baseVertex += entry.source->getBaseVertex();
+            entry.state.drawId = entry.source->getDrawId();
+        }
+    }
+
+    // Sorted so that draws with the same state end up next to each other.
+    // Matrices only need an order that keeps equal ones together, so their
+    // bytes are compared
+    std::stable_sort(
+        m_entries.begin(), m_entries.end(),
+        [](const Entry &a, const Entry &b) {
+            auto &x = a.state;
+            auto &y = b.state;
+            if (x.texture != y.texture) {
+                return std::less<const Texture2d *>()(x.texture, y.texture);
+            }
+            if (std::tie(x.vao, x.drawMode, x.indexType, x.hasModelMatrix,
+                         x.drawId) != std::tie(y.vao, y.drawMode, y.indexType,
+                                               y.hasModelMatrix, y.drawId)) {
+                return std::tie(x.vao, x.drawMode, x.indexType,
+                                x.hasModelMatrix, x.drawId) <
+                       std::tie(y.vao, y.drawMode, y.indexType,
+                                y.hasModelMatrix, y.drawId);
+            }
+            return x.hasModelMatrix &&
+                   std::memcmp(&x.modelMatrix, &y.modelMatrix,
+                               sizeof(glm::mat4)) < 0;
+        });
+
+    m_bucketCount = 0;
+    if (m_entries.empty()) {
+        return;
+    }
+
+    // Every group's transform goes up in one upload, apart from groups whose
+    // vertices bring their own. A window is as much of the buffer as the
+    // shader can see at once
+    std::size_t windowBytes = MAX_TRANSFORMS * sizeof(glm::mat4);
+    std::size_t alignment = getUniformBufferAlignment();
+    std::size_t windowStride =
+        (windowBytes + alignment - 1) / alignment * alignment;
+    m_transformData.clear();
+    for (std::size_t i = 0; i < m_entries.size(); i++) {
+        auto &state = m_entries[i].state;
+        if (state.hasModelMatrix &&
+            (i == 0 || !isSameState(state, m_entries[i - 1].state))) {
+            if (m_transformData.getBytes() % windowStride == windowBytes) {
+                m_transformData.alignTo(windowStride);
+            }
+            m_transformData.write(state.modelMatrix);
+        }
+    }
+    // The last window is always bound whole
+    if (m_transformData.getBytes() > 0) {
+        m_transforms.reserve(
+            (m_transformData.getBytes() + windowStride - 1) / windowStride *
+            windowStride);
+        m_transforms.update(m_transformData.getData(),
+                            m_transformData.getBytes());
+    }
+
+    // The commands are in the same order as the entries, so each group
+    // draws the commands from its first entry to its last
+    bool isIndirect = getMultiDrawElementsIndirect() != nullptr;
+    if (isIndirect) {
+        m_indirectCommands.clear();
+        for (auto &entry : m_entries) {
+            auto &command = entry.command;
+            m_indirectCommands.push_back(
+                {static_cast<GLuint>(command.count), 1,
+                 static_cast<GLuint>(command.firstIndex), command.baseVertex,
+                 0});
+        }
+        if (!m_indirectBuffer) {
+            glCheck(glGenBuffers(1, &m_indirectBuffer));
+        }
+        glCheck(glBindBuffer(DRAW_INDIRECT_BUFFER, m_indirectBuffer));
+        glCheck(glBufferData(
+            DRAW_INDIRECT_BUFFER,
+            m_indirectCommands.size() * sizeof(DrawElementsIndirectCommand),
+            m_indirectCommands.data(), GL_STREAM_DRAW));
+    }
+
+    const State *bound = nullptr;
+    std::size_t transformCount = 0;
+    for (std::size_t first = 0; first < m_entries.size();) {
+        auto &state = m_entries[first].state;
+        m_firstIndices.clear();
+        m_counts.clear();
+        m_baseVertices.clear();
+        std::size_t last = first;
+        for (; last < m_entries.size(); last++) {
+            auto &entry = m_entries[last];
+            if (!isSameState(entry.state, state)) {
+                break;
+            }
+            if (!isIndirect) {
+                m_firstIndices.push_back(entry.command.firstIndex);
+                m_counts.push_back(entry.command.count);
+                m_baseVertices.push_back(entry.command.baseVertex);
+            }
+        }
+
+        // Only what differs from the previous group is set again
+        Drawable drawable(state.vao, 0, state.indexType);
+        if (!bound || bound->vao != state.vao) {
+            drawable.bind();
+        }
+        if (state.texture && (!bound || bound->texture != state.texture)) {
+            state.texture->bind();
+        }
+        if (state.hasModelMatrix) {
+            auto window = static_cast<GLuint>(transformCount / MAX_TRANSFORMS);
+            auto drawId = static_cast<GLuint>(transformCount % MAX_TRANSFORMS);
+            if (drawId == 0) {
+                m_transforms.bindRange(TRANSFORM_BINDING,
+                                       window * windowStride, windowBytes);
+            }
+            glCheck(glVertexAttribI1ui(DRAW_ID_ATTRIBUTE, drawId));
+            transformCount++;
+        }
+        else {
+            glCheck(glVertexAttribI1ui(DRAW_ID_ATTRIBUTE, state.drawId));
+        }
+        if (isIndirect) {
+            drawable.drawSectionsIndirect(
+                first * sizeof(DrawElementsIndirectCommand),
+                static_cast<GLsizei>(last - first), state.drawMode);
+        }
+        else {
+            drawable.drawSections(m_firstIndices.data(), m_counts.data(),
+                                  m_baseVertices.data(),
+                                  static_cast<GLsizei>(m_counts.size()),
+                                  state.drawMode);
+        }
+        bound = &state;
+        m_bucketCount++;
+        first = last;
+    }
+    m_entries.clear();
+}
+
+std::size_t DrawList::getCommandCount() const
+{
+    return m_entries.size();
+}
+
+std::size_t DrawList::getBucketCount() const
+{
+    return m_bucketCount;
+}
+
+} // namespace gl
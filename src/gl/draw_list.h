@@ -0,0 +1,144 @@
+#pragma once
+
+#include "extensions.h"
+#include "shader.h"
+#include "textures.h"
+#include "vertex_array.h"
+
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace gl {
+
+/**
+ * @brief A section of a vertex array's indices to draw, the same as the
+ * arguments to Drawable::drawSection
+ */
+struct DrawCommand {
+    GLsizei count;
+    GLsizei firstIndex;
+    GLint baseVertex;
+};
+
+/**
+ * @brief Collects draws over a frame, then submits them grouped by the state
+ * they need. Every group of draws that share a vertex array, texture, draw
+ * mode and model matrix is drawn with one glMultiDrawElementsBaseVertex.
+ * The draws of a group can come from many meshes, as long as those meshes
+ * share a vertex array
+ *
+ * The model matrices of all the groups are uploaded together into the
+ * "Transforms" uniform block, and each group is given its index in the
+ * block through the draw id attribute. OpenGL 3.3 has no gl_DrawID, so the
+ * attribute is set before each group, and has to have no buffer attached
+ *
+ * Draws of a DrawSource have no model matrix here, as their vertices say
+ * which transform they use, so they are grouped by the rest of their state
+ * alone. The texts of a GlyphBuffer are drawn this way, with as many draw
+ * calls as atlas pages however many matrices they have
+ *
+ * Where the context has glMultiDrawElementsIndirect, every command goes up
+ * in one buffer and each group is drawn from its part of it. Otherwise the
+ * sections are passed to glMultiDrawElementsBaseVertex
+ *
+ * Draws are reordered to group them, so draws that must happen in order,
+ * such as blended ones that overlap, should go in separate lists
+ */
+class DrawList final {
+  public:
+    DrawList() = default;
+    ~DrawList();
+
+    DrawList(const DrawList &) = delete;
+    DrawList &operator=(const DrawList &) = delete;
+
+    // Where shaders drawn with a draw list read their transforms from.
+    // These must match the shaders
+    static constexpr GLuint TRANSFORM_BINDING = 0;
+    static constexpr GLuint DRAW_ID_ATTRIBUTE = 7;
+    static constexpr GLuint MAX_TRANSFORMS = 256;
+
+    /**
+     * @brief Adds a section of a drawable to the list
+     *
+     * @param texture The texture bound while drawing, or nullptr to leave
+     * whatever is bound
+     */
+    void add(const Drawable &drawable, const DrawCommand &command,
+             const glm::mat4 &modelMatrix, const Texture2d *texture = nullptr,
+             GLenum drawMode = GL_TRIANGLES);
+
+    // Adds all of the indices of a drawable
+    void add(const Drawable &drawable, const glm::mat4 &modelMatrix,
+             const Texture2d *texture = nullptr,
+             GLenum drawMode = GL_TRIANGLES);
+
+    /**
+     * @brief Adds a section of a source that may move before the list is
+     * submitted. Its vertex array and base vertex are looked up by submit(),
+     * so the source has to stay alive until then. The shader finds the
+     * transform of each vertex itself, rather than from "Transforms", and
+     * is given the source's draw id instead of an index into the block
+     *
+     * @param command The base vertex of the command is counted from the
+     * source's
+     */
+    void add(const DrawSource &source, const DrawCommand &command,
+             const Texture2d *texture = nullptr,
+             GLenum drawMode = GL_TRIANGLES);
+
+    /**
+     * @brief Draws everything in the list, then empties it. The shader the
+     * draws are for must be bound, with its "Transforms" block bound to
+     * TRANSFORM_BINDING
+     */
+    void submit();
+
+    // Draws waiting to be submitted
+    std::size_t getCommandCount() const;
+
+    // The number of groups, which is the number of draw calls, that the last
+    // submit drew with
+    std::size_t getBucketCount() const;
+
+  private:
+    struct State {
+        GLuint vao;
+        GLenum indexType;
+        GLenum drawMode;
+        const Texture2d *texture;
+        bool hasModelMatrix;
+        glm::mat4 modelMatrix;
+
+        // Only for draws without a model matrix
+        GLuint drawId;
+    };
+
+    struct Entry {
+        State state;
+        DrawCommand command;
+        const DrawSource *source;
+    };
+
+    static bool isSameState(const State &a, const State &b);
+
+    std::vector<Entry> m_entries;
+
+    // Model matrices of the groups, in windows of MAX_TRANSFORMS, which are
+    // each bound in turn
+    Std140Writer m_transformData;
+    UniformBuffer m_transforms;
+
+    // The commands of every entry, in the same order, for indirect draws
+    std::vector<DrawElementsIndirectCommand> m_indirectCommands;
+    GLuint m_indirectBuffer = 0;
+
+    // Reused between submits, so submitting does not allocate
+    std::vector<GLsizei> m_firstIndices;
+    std::vector<GLsizei> m_counts;
+    std::vector<GLint> m_baseVertices;
+
+    std::size_t m_bucketCount = 0;
+};
+
+} // namespace gl
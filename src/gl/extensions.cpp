@@ -0,0 +1,43 @@
+#include "extensions.h"
+
+#include <SFML/Window/Context.hpp>
+#include <cstring>
+
+namespace gl {
+
+bool isVersionAtLeast(int major, int minor)
+{
+    return GLVersion.major > major ||
+           (GLVersion.major == major && GLVersion.minor >= minor);
+}
+
+bool hasExtension(const char *name)
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++) {
+        auto extension = reinterpret_cast<const char *>(
+            glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i)));
+        if (extension && std::strcmp(extension, name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+MultiDrawElementsIndirectProc getMultiDrawElementsIndirect()
+{
+    static bool isLoaded = false;
+    static MultiDrawElementsIndirectProc function = nullptr;
+    if (!isLoaded) {
+        isLoaded = true;
+        if (isVersionAtLeast(4, 3) ||
+            hasExtension("GL_ARB_multi_draw_indirect")) {
+            function = reinterpret_cast<MultiDrawElementsIndirectProc>(
+                sf::Context::getFunction("glMultiDrawElementsIndirect"));
+        }
+    }
+    return function;
+}
+
+} // namespace gl
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// What the context supports beyond OpenGL 3.3, which is all the loader covers.
+// Functions from later versions are looked up by hand, and only need a
+// current context
+namespace gl {
+
+// Whether the context is at least this version of OpenGL
+bool isVersionAtLeast(int major, int minor);
+
+// Whether the context has an extension, eg "GL_KHR_debug"
+bool hasExtension(const char *name);
+
+constexpr GLenum DRAW_INDIRECT_BUFFER = 0x8F3F;
+
+/**
+ * @brief What each command read by glMultiDrawElementsIndirect looks like
+ */
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+using MultiDrawElementsIndirectProc = void(APIENTRY *)(GLenum mode,
+                                                       GLenum type,
+                                                       const void *indirect,
+                                                       GLsizei drawCount,
+                                                       GLsizei stride);
+
+/**
+ * @brief glMultiDrawElementsIndirect, from OpenGL 4.3 or
+ * ARB_multi_draw_indirect. Looked up the first time this is called
+ *
+ * @return MultiDrawElementsIndirectProc The function, or nullptr if the
+ * context has neither
+ */
+MultiDrawElementsIndirectProc getMultiDrawElementsIndirect();
+
+} // namespace gl
@@ -1,15 +1,173 @@
 #include "gl_errors.h"
+#include "extensions.h"
 
+#include <SFML/Window/Context.hpp>
 #include <glad/glad.h>
 #include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
 
-void glCheckError(const char *file, unsigned int line, const char *expression)
+namespace {
+// KHR_debug is not part of the loader, which only covers OpenGL 3.3, so
+// what it needs is declared here and loaded by hand
+constexpr GLenum DEBUG_OUTPUT = 0x92E0;
+constexpr GLenum DEBUG_TYPE_ERROR = 0x824C;
+constexpr GLenum DEBUG_SEVERITY_NOTIFICATION = 0x826B;
+constexpr GLint CONTEXT_FLAG_DEBUG_BIT = 0x2;
+
+using DebugProc = void(APIENTRY *)(GLenum source, GLenum type, GLuint id,
+                                   GLenum severity, GLsizei length,
+                                   const GLchar *message,
+                                   const void *userParam);
+using DebugMessageCallbackProc = void(APIENTRY *)(DebugProc callback,
+                                                  const void *userParam);
+
+std::atomic<std::size_t> errorCount{0};
+
+// The debug callback can be called from a driver thread
+std::mutex logMutex;
+
+std::string getFileName(const char *file)
+{
+    std::string fileString = file;
+    return fileString.substr(fileString.find_last_of("\\/") + 1);
+}
+
+bool hasDebugOutput()
+{
+    return gl::isVersionAtLeast(4, 3) || gl::hasExtension("GL_KHR_debug");
+}
+
+void APIENTRY onDebugMessage(GLenum, GLenum type, GLuint, GLenum severity,
+                             GLsizei, const GLchar *message, const void *)
+{
+    // Notifications are mostly drivers describing where buffers live
+    if (severity == DEBUG_SEVERITY_NOTIFICATION) {
+        return;
+    }
+    if (type == DEBUG_TYPE_ERROR) {
+        errorCount++;
+    }
+
+    // Output is not synchronous, so the call that ran last may already be
+    // past the one that caused this
+    const gl::CallSite *site =
+        gl::detail::lastCall.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(logMutex);
+    std::cerr << "OpenGL "
+              << (type == DEBUG_TYPE_ERROR ? "error" : "warning") << ": "
+              << message << "\n";
+    if (site) {
+        std::cerr << "Last checked call was in " << getFileName(site->file)
+                  << "(" << site->line << ")"
+                  << "\nExpression:\n   " << site->expression << "\n";
+    }
+    std::cerr << std::endl;
+}
+
+bool isDebugContext()
+{
+    GLint flags = 0;
+    glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
+    return flags & CONTEXT_FLAG_DEBUG_BIT;
+}
+
+bool enableDebugOutput(bool enable)
+{
+    auto debugMessageCallback = reinterpret_cast<DebugMessageCallbackProc>(
+        sf::Context::getFunction("glDebugMessageCallback"));
+    if (!debugMessageCallback) {
+        return false;
+    }
+    if (enable) {
+        debugMessageCallback(onDebugMessage, nullptr);
+        glEnable(DEBUG_OUTPUT);
+    }
+    else {
+        glDisable(DEBUG_OUTPUT);
+        debugMessageCallback(nullptr, nullptr);
+    }
+    return true;
+}
+} // namespace
+
+namespace gl {
+namespace detail {
+#ifdef NDEBUG
+ErrorPolicy errorPolicy = ErrorPolicy::Off;
+#else
+ErrorPolicy errorPolicy = ErrorPolicy::Full;
+#endif
+unsigned callsSinceSample = 0;
+std::atomic<const CallSite *> lastCall{nullptr};
+} // namespace detail
+
+ErrorPolicy setErrorPolicy(ErrorPolicy policy)
+{
+    using detail::errorPolicy;
+    if (policy == errorPolicy) {
+        return errorPolicy;
+    }
+    if (errorPolicy == ErrorPolicy::DebugOutput) {
+        enableDebugOutput(false);
+    }
+    if (policy == ErrorPolicy::DebugOutput &&
+        !(hasDebugOutput() && enableDebugOutput(true))) {
+        std::cerr << "KHR_debug is not supported, OpenGL errors will not be "
+                     "checked for\n";
+        policy = ErrorPolicy::Off;
+    }
+    else if (policy == ErrorPolicy::DebugOutput && !isDebugContext()) {
+        std::cerr << "The context is not a debug context, so the driver may "
+                     "not report OpenGL errors\n";
+    }
+
+    // Anything left over from before is not blamed on the next checked call
+    while (glGetError() != GL_NO_ERROR) {
+    }
+    detail::callsSinceSample = 0;
+    errorPolicy = policy;
+    return errorPolicy;
+}
+
+ErrorPolicy getErrorPolicy()
+{
+    return detail::errorPolicy;
+}
+
+const char *getErrorPolicyName(ErrorPolicy policy)
+{
+    switch (policy) {
+        case ErrorPolicy::Off:
+            return "off";
+
+        case ErrorPolicy::Sampled:
+            return "sampled";
+
+        case ErrorPolicy::Full:
+            return "full";
+
+        case ErrorPolicy::DebugOutput:
+            return "debug output";
+    }
+    return "";
+}
+
+std::size_t getErrorCount()
+{
+    return errorCount;
+}
+
+void detail::checkErrors(const CallSite &site)
 {
     // Get the last error
     GLenum errorCode = glGetError();
+    if (errorCode == GL_NO_ERROR) {
+        return;
+    }
 
     while (errorCode != GL_NO_ERROR) {
-        std::string fileString = file;
         std::string error = "Unknown error";
         std::string description = "No description";
 
@@ -42,17 +200,22 @@ void glCheckError(const char *file, unsigned int line, const char *expression)
                 break;
             }
         }
+        errorCount++;
 
         // Log the error
+        std::lock_guard<std::mutex> lock(logMutex);
         std::cerr << "An internal OpenGL call failed in "
-                  << fileString.substr(fileString.find_last_of("\\/") + 1)
-                  << "(" << line << ")."
-                  << "\nExpression:\n   " << expression
+                  << getFileName(site.file) << "(" << site.line << ")"
+                  << (errorPolicy == ErrorPolicy::Sampled
+                          ? ", or in a call before it."
+                          : ".")
+                  << "\nExpression:\n   " << site.expression
                   << "\nError description:\n   " << error << "\n   "
                   << description << "\n"
                   << std::endl;
-        glCheckError(file, line, expression);
-       // exit(-1);
-       throw std::runtime_error("");
+        errorCode = glGetError();
     }
+    throw std::runtime_error("");
 }
+
+} // namespace gl
@@ -1,18 +1,99 @@
 #pragma once
 
-#define DEBUG_GL_ERRORS
+#include <atomic>
+#include <cstddef>
+
+namespace gl {
+
+/**
+ * @brief Where a checked OpenGL call is in the source
+ */
+struct CallSite {
+    const char *file;
+    unsigned int line;
+    const char *expression;
+};
+
+/**
+ * @brief How glCheck looks for OpenGL errors
+ */
+enum class ErrorPolicy {
+    // Errors are not looked for
+    Off,
+
+    // glGetError is called after one in every ERROR_SAMPLE_INTERVAL calls.
+    // Finds errors that keep happening for a fraction of the cost of Full,
+    // but the call reported may come after the one that failed
+    Sampled,
+
+    // glGetError is called after every call, which finds exactly the call
+    // that failed but makes the CPU wait for the driver each time
+    Full,
+
+    // The driver reports errors through KHR_debug as they happen, and
+    // glCheck only remembers where it was, so the report says which checked
+    // call ran last. Costs nothing in the driver per call. Drivers only
+    // have to report anything to a debug context, so the context should be
+    // made with one
+    DebugOutput,
+};
+
+constexpr unsigned ERROR_SAMPLE_INTERVAL = 64;
+
+/**
+ * @brief Changes how errors are checked for. Needs a current context
+ *
+ * @return ErrorPolicy The policy now in use. DebugOutput falls back to Off if
+ * the context does not support KHR_debug
+ */
+ErrorPolicy setErrorPolicy(ErrorPolicy policy);
+ErrorPolicy getErrorPolicy();
+const char *getErrorPolicyName(ErrorPolicy policy);
+
+// Errors found since the program started, with any policy
+std::size_t getErrorCount();
+
+namespace detail {
+// Used by glCheckError, which is inline so that checking with a policy that
+// does nothing per call stays cheap
+extern ErrorPolicy errorPolicy;
+extern unsigned callsSinceSample;
+extern std::atomic<const CallSite *> lastCall;
+
+void checkErrors(const CallSite &site);
+} // namespace detail
+
+} // namespace gl
 
 // clang-format off
- 
+
 // This is OpenGL checking code from
 // https://github.com/SFML/SFML/blob/master/src/SFML/Graphics/GLCheck.hpp
-#ifdef DEBUG_GL_ERRORS
-   #define glCheck(expr) expr; { glCheckError(__FILE__, __LINE__, #expr); };
-#else
-    #define glCheck(call) call
-#endif
-
-void glCheckError(const char *file, unsigned int line,
-                  const char *expression);
+#define glCheck(expr) expr; { static constexpr gl::CallSite glCallSite{__FILE__, __LINE__, #expr}; glCheckError(glCallSite); };
+
+inline void glCheckError(const gl::CallSite &site)
+{
+    using namespace gl::detail;
+    switch (errorPolicy) {
+        case gl::ErrorPolicy::Off:
+            break;
+
+        case gl::ErrorPolicy::DebugOutput:
+            lastCall.store(&site, std::memory_order_relaxed);
+            break;
+
+        case gl::ErrorPolicy::Sampled:
+            if (++callsSinceSample < gl::ERROR_SAMPLE_INTERVAL) {
+                break;
+            }
+            callsSinceSample = 0;
+            checkErrors(site);
+            break;
+
+        case gl::ErrorPolicy::Full:
+            checkErrors(site);
+            break;
+    }
+}
 
 // clang-format on
@@ -1,4 +1,46 @@
 #include "primitive.h"
+#include "gl_errors.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace {
+// The most quads 16 bit indices can address
+constexpr GLsizei MAX_SHORT_INDEXED_QUADS = 65536 / 4;
+
+struct QuadIndexBuffer {
+    GLuint buffer = 0;
+    GLsizei quadCount = 0;
+};
+
+template <typename Index>
+void growQuadIndexBuffer(QuadIndexBuffer &indices, GLsizei quadCount,
+                         GLsizei maxQuadCount)
+{
+    // Grown geometrically, so a slowly growing text is not uploaded each time
+    quadCount = std::min(std::max({quadCount, indices.quadCount * 2, 256}),
+                         maxQuadCount);
+    std::vector<Index> data;
+    data.reserve(static_cast<std::size_t>(quadCount) * 6);
+    for (GLsizei quad = 0; quad < quadCount; quad++) {
+        auto i = static_cast<Index>(quad * 4);
+        data.insert(data.end(), {i, static_cast<Index>(i + 1),
+                                 static_cast<Index>(i + 2),
+                                 static_cast<Index>(i + 2),
+                                 static_cast<Index>(i + 3), i});
+    }
+
+    // Bound as an array buffer, so the element buffer of whichever vertex
+    // array is bound is left alone
+    if (!indices.buffer) {
+        glCheck(glGenBuffers(1, &indices.buffer));
+    }
+    glCheck(glBindBuffer(GL_ARRAY_BUFFER, indices.buffer));
+    glCheck(glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(Index),
+                         data.data(), GL_STATIC_DRAW));
+    indices.quadCount = quadCount;
+}
+} // namespace
 
 gl::VertexArray makeCubeVertexArray(GLfloat width, GLfloat height,
                                     GLfloat depth)
@@ -39,6 +81,7 @@ gl::VertexArray makeCubeVertexArray(GLfloat width, GLfloat height,
     }
 
     gl::VertexArray vao;
+    vao.create();
     vao.bind();
     vao.addVertexBuffer(3, vertices);
     vao.addVertexBuffer(2, textureCoords);
@@ -64,6 +107,7 @@ gl::VertexArray makeWireCubeVertexArray(GLfloat width, GLfloat height,
                                    6, 7, 7, 4, 0, 4, 1, 5, 2, 6, 3, 7};
 
     gl::VertexArray vao;
+    vao.create();
     vao.bind();
     vao.addVertexBuffer(3, vertices);
     vao.addIndexBuffer(indices);
@@ -86,9 +130,43 @@ gl::VertexArray makeQuadVertexArray(GLfloat relativeWidth,
                                           1.0f, 1.0f, 0.0f, 1.0f};
 
     gl::VertexArray vao;
+    vao.create();
     vao.bind();
     vao.addVertexBuffer(2, vertices);
     vao.addVertexBuffer(2, textureCoords);
     vao.addIndexBuffer(indices);
     return vao;
 }
+
+GLuint getUnitQuadBuffer()
+{
+    static GLuint buffer = 0;
+    if (!buffer) {
+        const GLfloat corners[] = {0, 0, 1, 0, 0, 1, 1, 1};
+        glCheck(glGenBuffers(1, &buffer));
+        glCheck(glBindBuffer(GL_ARRAY_BUFFER, buffer));
+        glCheck(glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners,
+                             GL_STATIC_DRAW));
+    }
+    return buffer;
+}
+
+GLuint getQuadIndexBuffer(GLsizei quadCount, GLenum &indexType)
+{
+    static QuadIndexBuffer shortIndices;
+    static QuadIndexBuffer intIndices;
+
+    if (quadCount <= MAX_SHORT_INDEXED_QUADS) {
+        if (quadCount > shortIndices.quadCount || !shortIndices.buffer) {
+            growQuadIndexBuffer<std::uint16_t>(shortIndices, quadCount,
+                                               MAX_SHORT_INDEXED_QUADS);
+        }
+        indexType = GL_UNSIGNED_SHORT;
+        return shortIndices.buffer;
+    }
+    if (quadCount > intIndices.quadCount) {
+        growQuadIndexBuffer<GLuint>(intIndices, quadCount, quadCount * 2);
+    }
+    indexType = GL_UNSIGNED_INT;
+    return intIndices.buffer;
+}
@@ -9,4 +9,23 @@ gl::VertexArray makeWireCubeVertexArray(GLfloat width, GLfloat height,
                                         GLfloat depth);
 
 gl::VertexArray makeQuadVertexArray(GLfloat relativeWidth,
-                                    GLfloat relativeHeight);
\ No newline at end of file
+                                    GLfloat relativeHeight);
+
+/**
+ * @brief Gets a buffer holding the corners of a 1x1 quad in triangle strip
+ * order. It is made the first time it is asked for, and then shared by every
+ * vertex array that draws quads as instances
+ */
+GLuint getUnitQuadBuffer();
+
+/**
+ * @brief Gets an index buffer for quads of 4 vertices each, drawn as two
+ * triangles. It is shared by every vertex array that draws quads, and grows
+ * as needed. Indices are 16 bit unless there are too many vertices for that,
+ * in which case a separate 32 bit buffer is used
+ *
+ * @param quadCount The number of quads the buffer has to cover
+ * @param indexType Set to the type of the indices in the buffer
+ * @return GLuint The buffer
+ */
+GLuint getQuadIndexBuffer(GLsizei quadCount, GLenum &indexType);
\ No newline at end of file
@@ -1,5 +1,8 @@
 #include "shader.h"
 #include "gl_errors.h"
+#include "state_cache.h"
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <sstream>
 #include <stdexcept>
@@ -7,6 +10,8 @@
 #include <iostream>
 
 namespace {
+std::size_t uniformUploads = 0;
+std::size_t uniformBufferUploads = 0;
 
 std::string loadFileContents(const std::string &path)
 {
@@ -89,7 +94,7 @@ Shader &Shader::operator=(Shader &&other)
 void Shader::create(const std::string &vertexFile,
                     const std::string &fragmentFile)
 {
-    glCheck(glUseProgram(0));
+    gl::useProgram(0);
     std::string vertFileFull("shaders/" + vertexFile + "_vertex.glsl");
     std::string fragFileFull("shaders/" + fragmentFile + "_fragment.glsl");
 
@@ -111,13 +116,14 @@ void Shader::create(const std::string &vertexFile,
 
 void Shader::destroy()
 {
+    gl::forgetProgram(m_handle);
     glCheck(glDeleteProgram(m_handle));
     m_handle = 0;
 }
 
 void Shader::bind() const
 {
-    glCheck(glUseProgram(m_handle));
+    gl::useProgram(m_handle);
 }
 
 UniformLocation Shader::getUniformLocation(const char *name)
@@ -127,34 +133,214 @@ UniformLocation Shader::getUniformLocation(const char *name)
     return location;
 }
 
+void Shader::bindUniformBlock(const char *name, GLuint binding)
+{
+    GLuint index = glCheck(glGetUniformBlockIndex(m_handle, name));
+    if (index != GL_INVALID_INDEX) {
+        glCheck(glUniformBlockBinding(m_handle, index, binding));
+    }
+}
+
+//
+//  Uniform buffer
+//
+UniformBuffer::~UniformBuffer()
+{
+    destroy();
+}
+
+UniformBuffer::UniformBuffer(UniformBuffer &&other)
+{
+    *this = std::move(other);
+}
+
+UniformBuffer &UniformBuffer::operator=(UniformBuffer &&other)
+{
+    destroy();
+    m_handle = other.m_handle;
+    m_capacity = other.m_capacity;
+    other.reset();
+    return *this;
+}
+
+void UniformBuffer::reserve(std::size_t bytes)
+{
+    if (!m_handle) {
+        glCheck(glGenBuffers(1, &m_handle));
+    }
+    if (bytes <= m_capacity) {
+        return;
+    }
+    // Grown geometrically, so data that grows a little each frame does not
+    // make new storage each frame
+    m_capacity = std::max(bytes, m_capacity * 2);
+    glCheck(glBindBuffer(GL_UNIFORM_BUFFER, m_handle));
+    glCheck(glBufferData(GL_UNIFORM_BUFFER, m_capacity, nullptr,
+                         GL_DYNAMIC_DRAW));
+}
+
+void UniformBuffer::update(const void *data, std::size_t bytes,
+                           std::size_t offset)
+{
+    reserve(offset + bytes);
+    glCheck(glBindBuffer(GL_UNIFORM_BUFFER, m_handle));
+    glCheck(glBufferSubData(GL_UNIFORM_BUFFER, offset, bytes, data));
+    uniformBufferUploads++;
+}
+
+void UniformBuffer::destroy()
+{
+    if (m_handle) {
+        glCheck(glDeleteBuffers(1, &m_handle));
+    }
+    reset();
+}
+
+void UniformBuffer::bindBase(GLuint binding) const
+{
+    glCheck(glBindBufferBase(GL_UNIFORM_BUFFER, binding, m_handle));
+}
+
+void UniformBuffer::bindRange(GLuint binding, std::size_t offset,
+                              std::size_t bytes) const
+{
+    glCheck(glBindBufferRange(GL_UNIFORM_BUFFER, binding, m_handle, offset,
+                              bytes));
+}
+
+std::size_t UniformBuffer::getCapacity() const
+{
+    return m_capacity;
+}
+
+void UniformBuffer::reset()
+{
+    m_handle = 0;
+    m_capacity = 0;
+}
+
+//
+//  std140 writer
+//
+void Std140Writer::write(GLfloat value)
+{
+    append(&value, 4, 4);
+}
+
+void Std140Writer::write(GLint value)
+{
+    append(&value, 4, 4);
+}
+
+void Std140Writer::write(GLuint value)
+{
+    append(&value, 4, 4);
+}
+
+void Std140Writer::write(const glm::vec2 &vector)
+{
+    append(glm::value_ptr(vector), 8, 8);
+}
+
+void Std140Writer::write(const glm::vec3 &vector)
+{
+    // Aligned like a vec4, though a scalar can go in the last 4 bytes
+    append(glm::value_ptr(vector), 12, 16);
+}
+
+void Std140Writer::write(const glm::vec4 &vector)
+{
+    append(glm::value_ptr(vector), 16, 16);
+}
+
+void Std140Writer::write(const glm::mat4 &matrix)
+{
+    // Stored as an array of 4 column vectors, the same as glm
+    append(glm::value_ptr(matrix), 64, 16);
+}
+
+void Std140Writer::alignTo(std::size_t alignment)
+{
+    m_data.resize((m_data.size() + alignment - 1) / alignment * alignment);
+}
+
+void Std140Writer::clear()
+{
+    m_data.clear();
+}
+
+const void *Std140Writer::getData() const
+{
+    return m_data.data();
+}
+
+std::size_t Std140Writer::getBytes() const
+{
+    return m_data.size();
+}
+
+void Std140Writer::append(const void *data, std::size_t bytes,
+                          std::size_t alignment)
+{
+    alignTo(alignment);
+    std::size_t offset = m_data.size();
+    m_data.resize(offset + bytes);
+    std::memcpy(m_data.data() + offset, data, bytes);
+}
+
+std::size_t getUniformBufferAlignment()
+{
+    static GLint alignment = 0;
+    if (!alignment) {
+        glCheck(glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment));
+    }
+    return static_cast<std::size_t>(alignment);
+}
+
+std::size_t getUniformUploadCount()
+{
+    return uniformUploads;
+}
+
+std::size_t getUniformBufferUploadCount()
+{
+    return uniformBufferUploads;
+}
+
 void loadUniform(UniformLocation location, const glm::vec3 &vector)
 {
+    uniformUploads++;
     glCheck(glUniform3fv(location.ptr, 1, glm::value_ptr(vector)));
 }
 
 void loadUniform(UniformLocation location, const glm::ivec3 &vector)
 {
+    uniformUploads++;
     glCheck(glUniform3iv(location.ptr, 1, glm::value_ptr(vector)));
 }
 
 void loadUniform(UniformLocation location, const glm::mat4 &matrix)
 {
+    uniformUploads++;
     glCheck(
         glUniformMatrix4fv(location.ptr, 1, GL_FALSE, glm::value_ptr(matrix)));
 }
 
 void loadUniform(UniformLocation location, GLint value)
 {
+    uniformUploads++;
     glCheck(glUniform1i(location.ptr, value));
 }
 
 void loadUniform(UniformLocation location, GLuint value)
 {
+    uniformUploads++;
     glCheck(glUniform1ui(location.ptr, value));
 }
 
 void loadUniform(UniformLocation location, GLfloat value)
 {
+    uniformUploads++;
     glCheck(glUniform1f(location.ptr, value));
 }
 
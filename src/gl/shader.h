@@ -1,7 +1,9 @@
 #pragma once
 
+#include <cstdint>
 #include <glad/glad.h>
 #include <string>
+#include <vector>
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -34,10 +36,93 @@ class Shader final {
 
     UniformLocation getUniformLocation(const char *name);
 
+    // Makes a uniform block of the shader read from a uniform buffer binding
+    // point. Blocks the shader does not have are ignored
+    void bindUniformBlock(const char *name, GLuint binding);
+
   private:
     GLuint m_handle = 0;
 };
 
+/**
+ * @brief Wrapper for an OpenGL uniform buffer object (aka UBO), which holds
+ * the values of a uniform block so that many shaders can share them, and so
+ * they can be set in one upload rather than a call for each uniform
+ */
+class UniformBuffer final {
+  public:
+    UniformBuffer() = default;
+    ~UniformBuffer();
+
+    UniformBuffer(UniformBuffer &&other);
+    UniformBuffer &operator=(UniformBuffer &&other);
+
+    UniformBuffer(const UniformBuffer &) = delete;
+    UniformBuffer &operator=(const UniformBuffer &) = delete;
+
+    /**
+     * @brief Makes sure the buffer holds at least this many bytes. Growing
+     * throws away what was in the buffer
+     */
+    void reserve(std::size_t bytes);
+
+    // Writes to the buffer, growing it if the data does not fit
+    void update(const void *data, std::size_t bytes, std::size_t offset = 0);
+    void destroy();
+
+    // Binds all of the buffer, or part of it, to a binding point. The offset
+    // must be a multiple of getUniformBufferAlignment()
+    void bindBase(GLuint binding) const;
+    void bindRange(GLuint binding, std::size_t offset,
+                   std::size_t bytes) const;
+
+    std::size_t getCapacity() const;
+
+  private:
+    void reset();
+
+    GLuint m_handle = 0;
+    std::size_t m_capacity = 0;
+};
+
+/**
+ * @brief Packs values one after the other following the std140 layout
+ * rules, so they can be uploaded straight into a uniform block. Elements of
+ * arrays are padded to 16 bytes under std140, so arrays of scalars should
+ * be written as vec4s
+ */
+class Std140Writer final {
+  public:
+    void write(GLfloat value);
+    void write(GLint value);
+    void write(GLuint value);
+    void write(const glm::vec2 &vector);
+    void write(const glm::vec3 &vector);
+    void write(const glm::vec4 &vector);
+    void write(const glm::mat4 &matrix);
+
+    // Pads up to a multiple of the alignment, for example 16 at the end of
+    // a struct, or getUniformBufferAlignment() between blocks
+    void alignTo(std::size_t alignment);
+    void clear();
+
+    const void *getData() const;
+    std::size_t getBytes() const;
+
+  private:
+    void append(const void *data, std::size_t bytes, std::size_t alignment);
+
+    std::vector<std::uint8_t> m_data;
+};
+
+// The alignment that offsets given to UniformBuffer::bindRange need
+std::size_t getUniformBufferAlignment();
+
+// Calls to loadUniform, and uploads to uniform buffers, since the program
+// started
+std::size_t getUniformUploadCount();
+std::size_t getUniformBufferUploadCount();
+
 // Functons for shaders
 void loadUniform(UniformLocation location, const glm::ivec3 &vector);
 void loadUniform(UniformLocation location, const glm::vec3 &vector);
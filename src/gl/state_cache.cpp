@@ -0,0 +1,184 @@
+#include "state_cache.h"
+#include "gl_errors.h"
+
+#include <array>
+
+namespace {
+// Stands in for state that is not known, so it is always set next time
+constexpr GLuint UNKNOWN = ~0u;
+constexpr int UNKNOWN_FLAG = -1;
+
+// Only the units and targets that are used are tracked. Anything else is
+// always passed on
+constexpr GLuint TRACKED_UNITS = 8;
+constexpr std::array<GLenum, 3> TRACKED_TARGETS = {
+    GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BUFFER};
+
+struct State {
+    GLuint program = UNKNOWN;
+    GLuint vao = UNKNOWN;
+    GLuint activeUnit = UNKNOWN;
+    std::array<std::array<GLuint, TRACKED_TARGETS.size()>, TRACKED_UNITS>
+        textures;
+
+    int blending = UNKNOWN_FLAG;
+    GLenum blendSource = UNKNOWN;
+    GLenum blendDestination = UNKNOWN;
+    int depthTest = UNKNOWN_FLAG;
+    int depthWrite = UNKNOWN_FLAG;
+
+    State()
+    {
+        for (auto &unit : textures) {
+            unit.fill(UNKNOWN);
+        }
+    }
+};
+
+State state;
+std::size_t issuedChanges = 0;
+std::size_t skippedChanges = 0;
+
+// Updates the cached value, returning whether it actually changed
+template <typename T> bool change(T &current, T value)
+{
+    if (current == value) {
+        skippedChanges++;
+        return false;
+    }
+    current = value;
+    issuedChanges++;
+    return true;
+}
+
+GLuint *findTexture(GLenum target, GLuint unit)
+{
+    if (unit >= TRACKED_UNITS) {
+        return nullptr;
+    }
+    for (std::size_t i = 0; i < TRACKED_TARGETS.size(); i++) {
+        if (TRACKED_TARGETS[i] == target) {
+            return &state.textures[unit][i];
+        }
+    }
+    return nullptr;
+}
+
+void setCapability(GLenum capability, int &current, bool enabled)
+{
+    if (change(current, enabled ? 1 : 0)) {
+        if (enabled) {
+            glCheck(glEnable(capability));
+        }
+        else {
+            glCheck(glDisable(capability));
+        }
+    }
+}
+} // namespace
+
+namespace gl {
+
+void useProgram(GLuint program)
+{
+    if (change(state.program, program)) {
+        glCheck(glUseProgram(program));
+    }
+}
+
+void bindVertexArray(GLuint vao)
+{
+    if (change(state.vao, vao)) {
+        glCheck(glBindVertexArray(vao));
+    }
+}
+
+void bindTexture(GLenum target, GLuint texture, GLuint unit)
+{
+    // The unit is made active even when the texture is already bound, as
+    // callers go on to edit the texture through the active unit
+    if (change(state.activeUnit, unit)) {
+        glCheck(glActiveTexture(GL_TEXTURE0 + unit));
+    }
+    GLuint *bound = findTexture(target, unit);
+    if (bound && *bound == texture) {
+        skippedChanges++;
+        return;
+    }
+    issuedChanges++;
+    glCheck(glBindTexture(target, texture));
+    if (bound) {
+        *bound = texture;
+    }
+}
+
+void setBlending(bool enabled)
+{
+    setCapability(GL_BLEND, state.blending, enabled);
+}
+
+void setBlendFunction(GLenum source, GLenum destination)
+{
+    if (state.blendSource == source && state.blendDestination == destination) {
+        skippedChanges++;
+        return;
+    }
+    issuedChanges++;
+    state.blendSource = source;
+    state.blendDestination = destination;
+    glCheck(glBlendFunc(source, destination));
+}
+
+void setDepthTest(bool enabled)
+{
+    setCapability(GL_DEPTH_TEST, state.depthTest, enabled);
+}
+
+void setDepthWrite(bool enabled)
+{
+    if (change(state.depthWrite, enabled ? 1 : 0)) {
+        glCheck(glDepthMask(enabled ? GL_TRUE : GL_FALSE));
+    }
+}
+
+void forgetProgram(GLuint program)
+{
+    if (state.program == program) {
+        state.program = UNKNOWN;
+    }
+}
+
+void forgetVertexArray(GLuint vao)
+{
+    if (state.vao == vao) {
+        state.vao = UNKNOWN;
+    }
+}
+
+void forgetTexture(GLuint texture)
+{
+    for (auto &unit : state.textures) {
+        for (auto &bound : unit) {
+            if (bound == texture) {
+                bound = UNKNOWN;
+            }
+        }
+    }
+}
+
+void resetStateCache()
+{
+    state = State();
+}
+
+std::size_t getIssuedStateChangeCount()
+{
+    return issuedChanges;
+}
+
+std::size_t getSkippedStateChangeCount()
+{
+    return skippedChanges;
+}
+
+} // namespace gl
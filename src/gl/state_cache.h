@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <glad/glad.h>
+
+// Tracks the OpenGL state that is changed most often, so that setting
+// something that is already set does not reach the driver. This only works
+// if all changes to that state go through these functions
+namespace gl {
+
+void useProgram(GLuint program);
+void bindVertexArray(GLuint vao);
+
+/**
+ * @brief Binds a texture to a texture unit, making that unit active if it is
+ * not already. The unit is left active even if the bind itself is skipped,
+ * so the texture can be edited straight after
+ *
+ * @param target What kind of texture it is, eg GL_TEXTURE_2D
+ */
+void bindTexture(GLenum target, GLuint texture, GLuint unit = 0);
+
+void setBlending(bool enabled);
+void setBlendFunction(GLenum source, GLenum destination);
+void setDepthTest(bool enabled);
+void setDepthWrite(bool enabled);
+
+// Objects that are deleted have their names reused, so they have to be
+// forgotten about before they go
+void forgetProgram(GLuint program);
+void forgetVertexArray(GLuint vao);
+void forgetTexture(GLuint texture);
+
+// Forgets everything, for after something outside of this has changed the
+// state, so the next change of each kind is always passed on
+void resetStateCache();
+
+// State changes that were passed on to OpenGL, and that were skipped because
+// the state was already set, since the program started. Switching the active
+// texture unit counts as a change of its own
+std::size_t getIssuedStateChangeCount();
+std::size_t getSkippedStateChangeCount();
+
+} // namespace gl
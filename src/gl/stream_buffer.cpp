@@ -0,0 +1,132 @@
+#include "stream_buffer.h"
+#include "gl_errors.h"
+
+#include <algorithm>
+
+namespace gl {
+
+StreamBuffer::~StreamBuffer()
+{
+    destroy();
+}
+
+StreamBuffer::StreamBuffer(StreamBuffer &&other)
+{
+    *this = std::move(other);
+}
+
+StreamBuffer &StreamBuffer::operator=(StreamBuffer &&other)
+{
+    destroy();
+    m_handle = other.m_handle;
+    m_size = other.m_size;
+    m_offset = other.m_offset;
+    m_generation = other.m_generation;
+    m_frameBytes = other.m_frameBytes;
+    m_isFull = other.m_isFull;
+    m_orphanCount = other.m_orphanCount;
+    m_writtenBytes = other.m_writtenBytes;
+    other.reset();
+    return *this;
+}
+
+void StreamBuffer::create(std::size_t bytes)
+{
+    if (!m_handle) {
+        glCheck(glGenBuffers(1, &m_handle));
+    }
+    orphan(bytes);
+}
+
+void StreamBuffer::destroy()
+{
+    glCheck(glDeleteBuffers(1, &m_handle));
+    reset();
+}
+
+void StreamBuffer::beginFrame()
+{
+    // Whatever was written before may still be drawn from, so rather than
+    // wait for the GPU the buffer gets new storage to write into. Doing it
+    // mid frame would lose writes whose draws are still waiting in a list
+    if (m_isFull || m_offset + m_frameBytes > m_size) {
+        orphan(m_frameBytes > m_size ? m_frameBytes * 2 : m_size);
+        m_orphanCount++;
+    }
+    m_frameBytes = 0;
+    m_isFull = false;
+}
+
+void *StreamBuffer::map(std::size_t bytes, std::size_t alignment,
+                        std::size_t &offset)
+{
+    offset = (m_offset + alignment - 1) / alignment * alignment;
+    m_frameBytes += bytes + (offset - m_offset);
+    if (offset + bytes > m_size) {
+        m_isFull = true;
+        offset = 0;
+        return nullptr;
+    }
+    if (bytes == 0) {
+        return nullptr;
+    }
+
+    glCheck(glBindBuffer(GL_ARRAY_BUFFER, m_handle));
+    void *data = glCheck(glMapBufferRange(
+        GL_ARRAY_BUFFER, offset, bytes,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+            GL_MAP_UNSYNCHRONIZED_BIT));
+    m_offset = offset + bytes;
+    m_writtenBytes += bytes;
+    return data;
+}
+
+bool StreamBuffer::unmap()
+{
+    glCheck(glBindBuffer(GL_ARRAY_BUFFER, m_handle));
+    GLboolean isIntact = glCheck(glUnmapBuffer(GL_ARRAY_BUFFER));
+    return isIntact == GL_TRUE;
+}
+
+GLuint StreamBuffer::getHandle() const
+{
+    return m_handle;
+}
+
+unsigned StreamBuffer::getGeneration() const
+{
+    return m_generation;
+}
+
+std::size_t StreamBuffer::getOrphanCount() const
+{
+    return m_orphanCount;
+}
+
+std::size_t StreamBuffer::getWrittenBytes() const
+{
+    return m_writtenBytes;
+}
+
+void StreamBuffer::orphan(std::size_t bytes)
+{
+    glCheck(glBindBuffer(GL_ARRAY_BUFFER, m_handle));
+    glCheck(glBufferData(GL_ARRAY_BUFFER, bytes, nullptr, GL_STREAM_DRAW));
+    m_size = bytes;
+    m_offset = 0;
+    m_generation++;
+}
+
+void StreamBuffer::reset()
+{
+    m_handle = 0;
+    m_size = 0;
+    m_offset = 0;
+    m_generation = 0;
+    m_frameBytes = 0;
+    m_isFull = false;
+    m_orphanCount = 0;
+    m_writtenBytes = 0;
+}
+
+} // namespace gl
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <glad/glad.h>
+
+namespace gl {
+
+/**
+ * @brief A vertex buffer for data that is rewritten every frame. Writes go
+ * one after the other around a ring, through unsynchronized mappings, so
+ * the driver never has to wait for the GPU to finish with earlier writes.
+ *
+ * When the ring is close to full its storage is orphaned, which gives it
+ * fresh storage while draws already issued keep the old one. Draws can be
+ * held in a draw list until the end of the frame, so this only happens in
+ * beginFrame(). Writes that do not fit before then fail
+ */
+class StreamBuffer final {
+  public:
+    StreamBuffer() = default;
+    ~StreamBuffer();
+
+    StreamBuffer(StreamBuffer &&other);
+    StreamBuffer &operator=(StreamBuffer &&other);
+
+    StreamBuffer(const StreamBuffer &) = delete;
+    StreamBuffer &operator=(const StreamBuffer &) = delete;
+
+    void create(std::size_t bytes);
+    void destroy();
+
+    /**
+     * @brief Has to be called each frame before anything is mapped, once the
+     * draws of the frame before have been issued. Starts the ring again in
+     * fresh storage if the last frame's writes might not fit in what is left,
+     * growing it if they did not fit at all
+     */
+    void beginFrame();
+
+    /**
+     * @brief Maps the next part of the ring for writing. Only one part can be
+     * mapped at a time
+     *
+     * @param bytes The size of the part
+     * @param alignment The offset of the part is a multiple of this, so it
+     * can be drawn from with a base vertex
+     * @param offset Set to where the part starts in the buffer
+     * @return void* The part to write to, or nullptr if it could not be
+     * mapped, or there is no room left this frame
+     */
+    void *map(std::size_t bytes, std::size_t alignment, std::size_t &offset);
+
+    /**
+     * @brief Finishes writing the part that was mapped
+     *
+     * @return false if the driver lost what was written while it was mapped,
+     * which then has to be written again
+     */
+    bool unmap();
+
+    GLuint getHandle() const;
+
+    /**
+     * @brief Changes whenever the contents are thrown away, after which
+     * anything that was written before has to be written again
+     */
+    unsigned getGeneration() const;
+
+    std::size_t getOrphanCount() const;
+    std::size_t getWrittenBytes() const;
+
+  private:
+    void orphan(std::size_t bytes);
+    void reset();
+
+    GLuint m_handle = 0;
+    std::size_t m_size = 0;
+    std::size_t m_offset = 0;
+    unsigned m_generation = 0;
+
+    // Bytes asked for since beginFrame, including any that did not fit
+    std::size_t m_frameBytes = 0;
+    bool m_isFull = false;
+
+    std::size_t m_orphanCount = 0;
+    std::size_t m_writtenBytes = 0;
+};
+} // namespace gl
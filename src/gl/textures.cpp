@@ -1,5 +1,7 @@
 #include "textures.h"
 #include "gl_errors.h"
+#include "state_cache.h"
+#include <algorithm>
 #include <iostream>
 
 namespace {
@@ -7,7 +9,6 @@ GLuint createTexture()
 {
     GLuint handle;
     glCheck(glGenTextures(1, &handle));
-    glCheck(glActiveTexture(GL_TEXTURE0));
     return handle;
 }
 
@@ -29,8 +30,54 @@ bool bufferImage(GLenum param, const std::string &file)
     return true;
 }
 
+GLenum pixelFormat(gl::TextureFormat format)
+{
+    switch (format) {
+        case gl::TextureFormat::RGB8:
+            return GL_RGB;
+
+        case gl::TextureFormat::R8:
+            return GL_RED;
+
+        default:
+            return GL_RGBA;
+    }
+}
+
+/**
+ * @brief Uploads a tightly packed image to the bound 2D texture
+ */
+void texImage2d(unsigned int width, unsigned int height,
+                const sf::Uint8 *pixels, gl::TextureFormat format)
+{
+    GLint internalFormat = GL_RGBA8;
+    switch (format) {
+        case gl::TextureFormat::RGBA8:
+            break;
+
+        case gl::TextureFormat::RGB8:
+            internalFormat = GL_RGB8;
+            break;
+
+        case gl::TextureFormat::R8: {
+            internalFormat = GL_R8;
+            const GLint swizzle[] = {GL_ONE, GL_ONE, GL_ONE, GL_RED};
+            glCheck(glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA,
+                                     swizzle));
+            break;
+        }
+    }
+
+    // Rows of 1 and 3 byte pixels are not always a multiple of 4 bytes long
+    glCheck(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+    glCheck(glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0,
+                         pixelFormat(format), GL_UNSIGNED_BYTE, pixels));
+    glCheck(glPixelStorei(GL_UNPACK_ALIGNMENT, 4));
+}
+
 void destroyTexture(GLuint *texture)
 {
+    gl::forgetTexture(*texture);
     glCheck(glDeleteTextures(1, texture));
     *texture = 0;
 }
@@ -136,18 +183,14 @@ void Texture2d::create(const std::string &file)
 }
 
 void Texture2d::create(unsigned int width, unsigned int height,
-                       const sf::Uint8 *pixels)
+                       const sf::Uint8 *pixels, TextureFormat format)
 {
     if (!m_handle) {
         m_handle = createTexture();
     }
     bind();
 
-    sf::Image img;
-    img.create(width, height, pixels);
-    glCheck(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, img.getSize().x,
-                         img.getSize().y, 0, GL_RGBA, GL_UNSIGNED_BYTE,
-                         img.getPixelsPtr()));
+    texImage2d(width, height, pixels, format);
 
     glCheck(glGenerateMipmap(GL_TEXTURE_2D));
     glCheck(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
@@ -158,6 +201,33 @@ void Texture2d::create(unsigned int width, unsigned int height,
     m_hasTexture = true;
 }
 
+void Texture2d::update(unsigned int x, unsigned int y, unsigned int width,
+                       unsigned int height, unsigned int rowLength,
+                       const sf::Uint8 *pixels, TextureFormat format)
+{
+    bind();
+
+    glCheck(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+    glCheck(glPixelStorei(GL_UNPACK_ROW_LENGTH, rowLength));
+    glCheck(glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height,
+                            pixelFormat(format), GL_UNSIGNED_BYTE, pixels));
+    glCheck(glPixelStorei(GL_UNPACK_ROW_LENGTH, 0));
+    glCheck(glPixelStorei(GL_UNPACK_ALIGNMENT, 4));
+}
+
+void Texture2d::generateMipmaps()
+{
+    bind();
+    glCheck(glGenerateMipmap(GL_TEXTURE_2D));
+}
+
+void Texture2d::setFilters(GLenum minFilter, GLenum magFilter)
+{
+    bind();
+    glCheck(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter));
+    glCheck(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, magFilter));
+}
+
 void Texture2d::destroy()
 {
     destroyTexture(&m_handle);
@@ -165,7 +235,7 @@ void Texture2d::destroy()
 
 void Texture2d::bind() const
 {
-    glCheck(glBindTexture(GL_TEXTURE_2D, m_handle));
+    gl::bindTexture(GL_TEXTURE_2D, m_handle);
 }
 
 bool Texture2d::textureExists() const
@@ -282,7 +352,7 @@ void TextureArray::destroy()
 
 void TextureArray::bind() const
 {
-    glCheck(glBindTexture(GL_TEXTURE_2D_ARRAY, m_handle));
+    gl::bindTexture(GL_TEXTURE_2D_ARRAY, m_handle);
 }
 
 void TextureArray::reset()
@@ -293,4 +363,93 @@ void TextureArray::reset()
     m_textureSize = 0;
 }
 
+//
+//  Buffer Texture
+//
+BufferTexture::~BufferTexture()
+{
+    destroy();
+}
+
+BufferTexture::BufferTexture(BufferTexture &&other)
+{
+    *this = std::move(other);
+}
+
+BufferTexture &BufferTexture::operator=(BufferTexture &&other)
+{
+    destroy();
+    m_handle = other.m_handle;
+    m_buffer = other.m_buffer;
+    m_bytes = other.m_bytes;
+    m_capacity = other.m_capacity;
+    other.reset();
+    return *this;
+}
+
+void BufferTexture::update(const std::vector<GLfloat> &data)
+{
+    if (!m_handle) {
+        glCheck(glGenBuffers(1, &m_buffer));
+        glCheck(glGenTextures(1, &m_handle));
+    }
+    m_bytes = data.size() * sizeof(GLfloat);
+
+    // The buffer only ever grows, so tables that change often are rewritten
+    // in place
+    glCheck(glBindBuffer(GL_TEXTURE_BUFFER, m_buffer));
+    if (m_bytes > m_capacity) {
+        m_capacity = std::max(m_bytes, m_capacity * 2);
+        glCheck(glBufferData(GL_TEXTURE_BUFFER, m_capacity, nullptr,
+                             GL_DYNAMIC_DRAW));
+        gl::bindTexture(GL_TEXTURE_BUFFER, m_handle);
+        glCheck(glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_buffer));
+    }
+    if (m_bytes > 0) {
+        glCheck(glBufferSubData(GL_TEXTURE_BUFFER, 0, m_bytes, data.data()));
+    }
+    glCheck(glBindBuffer(GL_TEXTURE_BUFFER, 0));
+}
+
+void BufferTexture::update(const std::vector<GLfloat> &data,
+                           std::size_t first, std::size_t count)
+{
+    if (!m_handle || data.size() * sizeof(GLfloat) > m_capacity) {
+        update(data);
+        return;
+    }
+    m_bytes = data.size() * sizeof(GLfloat);
+    glCheck(glBindBuffer(GL_TEXTURE_BUFFER, m_buffer));
+    glCheck(glBufferSubData(GL_TEXTURE_BUFFER, first * sizeof(GLfloat),
+                            count * sizeof(GLfloat), data.data() + first));
+    glCheck(glBindBuffer(GL_TEXTURE_BUFFER, 0));
+}
+
+void BufferTexture::destroy()
+{
+    if (m_handle) {
+        destroyTexture(&m_handle);
+        glCheck(glDeleteBuffers(1, &m_buffer));
+    }
+    reset();
+}
+
+void BufferTexture::bind(GLuint unit) const
+{
+    gl::bindTexture(GL_TEXTURE_BUFFER, m_handle, unit);
+}
+
+std::size_t BufferTexture::getBytes() const
+{
+    return m_bytes;
+}
+
+void BufferTexture::reset()
+{
+    m_handle = 0;
+    m_buffer = 0;
+    m_bytes = 0;
+    m_capacity = 0;
+}
+
 } // namespace gl
\ No newline at end of file
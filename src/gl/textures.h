@@ -4,9 +4,25 @@
 #include <array>
 #include <glad/glad.h>
 #include <string>
+#include <vector>
 
 namespace gl {
 
+/**
+ * @brief The pixel layout of a texture, and how it is stored on the GPU
+ */
+enum class TextureFormat {
+    // 8 bits for each of red, green, blue and alpha
+    RGBA8,
+
+    // 8 bits for each of red, green and blue, alpha is always 1
+    RGB8,
+
+    // A single 8 bit channel, which is sampled as white with the value as the
+    // alpha so it can be drawn like a regular RGBA texture
+    R8,
+};
+
 /**
  * @brief Wrapper for an OpenGL cube-mapped texture object
  */
@@ -39,7 +55,24 @@ class Texture2d final {
     void create(const sf::Image &image);
     void create(const std::string &file);
     void create(unsigned int width, unsigned int height,
-                const sf::Uint8 *pixels);
+                const sf::Uint8 *pixels,
+                TextureFormat format = TextureFormat::RGBA8);
+
+    /**
+     * @brief Replaces part of the texture, leaving the rest as it is. The
+     * mipmaps are not updated, see generateMipmaps
+     *
+     * @param rowLength The number of pixels in each row of the source image,
+     * so the area can be read straight out of a larger image
+     * @param pixels The top left pixel of the area in the source image
+     */
+    void update(unsigned int x, unsigned int y, unsigned int width,
+                unsigned int height, unsigned int rowLength,
+                const sf::Uint8 *pixels,
+                TextureFormat format = TextureFormat::RGBA8);
+    // Rebuilds every mipmap level from the full size image
+    void generateMipmaps();
+    void setFilters(GLenum minFilter, GLenum magFilter);
     void destroy();
     void bind() const;
     bool textureExists() const;
@@ -76,6 +109,47 @@ class TextureArray final {
     GLuint m_textureSize = 0;
 };
 
+/**
+ * @brief A buffer of floats that shaders read with texelFetch through a
+ * samplerBuffer, four at a time. Used for tables too large for uniforms. No
+ * OpenGL objects are made until the first update
+ */
+class BufferTexture final {
+  public:
+    BufferTexture() = default;
+    ~BufferTexture();
+
+    BufferTexture(BufferTexture &&other);
+    BufferTexture &operator=(BufferTexture &&other);
+
+    BufferTexture(const BufferTexture &) = delete;
+    BufferTexture &operator=(const BufferTexture &) = delete;
+
+    // Replaces the contents. The size must be a multiple of 4
+    void update(const std::vector<GLfloat> &data);
+
+    /**
+     * @brief Same as update(data), but only sends the floats from first to
+     * first + count, assuming the rest is already on the GPU. Everything is
+     * sent if the buffer has to grow
+     */
+    void update(const std::vector<GLfloat> &data, std::size_t first,
+                std::size_t count);
+    void destroy();
+
+    void bind(GLuint unit) const;
+
+    std::size_t getBytes() const;
+
+  private:
+    void reset();
+
+    GLuint m_handle = 0;
+    GLuint m_buffer = 0;
+    std::size_t m_bytes = 0;
+    std::size_t m_capacity = 0;
+};
+
 sf::Image loadRawImageFile(const std::string &file);
 
 } // namespace gl
\ No newline at end of file
@@ -1,12 +1,20 @@
 #include "vertex_array.h"
+#include "extensions.h"
 #include "gl_errors.h"
+#include "state_cache.h"
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
 
 namespace {
+std::size_t createdObjects = 0;
+std::size_t drawCalls = 0;
+
 GLuint genVbo()
 {
     GLuint vertexBuffer;
     glCheck(glGenBuffers(1, &vertexBuffer));
+    createdObjects++;
     glCheck(glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer));
     return vertexBuffer;
 }
@@ -21,12 +29,30 @@ void vertexAttribPointer(GLuint index, GLint mag, GLenum type)
 {
     glCheck(glVertexAttribPointer(index, mag, type, GL_FALSE, 0, (GLvoid *)0));
 }
+
+GLsizei attributeBytes(const gl::VertexAttribute &attribute)
+{
+    switch (attribute.type) {
+        case GL_BYTE:
+        case GL_UNSIGNED_BYTE:
+            return attribute.magnitude;
+
+        case GL_SHORT:
+        case GL_UNSIGNED_SHORT:
+        case GL_HALF_FLOAT:
+            return attribute.magnitude * 2;
+
+        default:
+            return attribute.magnitude * 4;
+    }
+}
 } // namespace
 
 namespace gl {
-Drawable::Drawable(GLuint vao, GLsizei indices)
+Drawable::Drawable(GLuint vao, GLsizei indices, GLenum indexType)
     : m_handle(vao)
     , m_indicesCount(indices)
+    , m_indexType(indexType)
 {
 }
 
@@ -38,21 +64,88 @@ void Drawable::bindAndDraw(GLenum drawMode) const
 
 void Drawable::bind() const
 {
-    glCheck(glBindVertexArray(m_handle));
+    gl::bindVertexArray(m_handle);
 }
 
 void Drawable::draw(GLenum drawMode) const
 {
-    glCheck(glDrawElements(drawMode, m_indicesCount, GL_UNSIGNED_INT, nullptr));
+    glCheck(glDrawElements(drawMode, m_indicesCount, m_indexType, nullptr));
+    drawCalls++;
+}
+
+void Drawable::drawSection(GLsizei firstIndex, GLsizei count,
+                           GLint baseVertex, GLenum drawMode) const
+{
+    std::size_t indexBytes = m_indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+    auto offset = reinterpret_cast<const GLvoid *>(firstIndex * indexBytes);
+    if (baseVertex == 0) {
+        glCheck(glDrawElements(drawMode, count, m_indexType, offset));
+    }
+    else {
+        glCheck(glDrawElementsBaseVertex(drawMode, count, m_indexType, offset,
+                                         baseVertex));
+    }
+    drawCalls++;
+}
+
+void Drawable::drawInstances(GLsizei vertexCount, GLsizei instanceCount,
+                             GLenum drawMode) const
+{
+    glCheck(glDrawArraysInstanced(drawMode, 0, vertexCount, instanceCount));
+    drawCalls++;
+}
+
+void Drawable::drawSections(const GLsizei *firstIndices, const GLsizei *counts,
+                            const GLint *baseVertices, GLsizei sectionCount,
+                            GLenum drawMode) const
+{
+    if (sectionCount == 1) {
+        drawSection(firstIndices[0], counts[0], baseVertices[0], drawMode);
+        return;
+    }
+    // Kept between calls, so drawing does not allocate every frame
+    static std::vector<const GLvoid *> offsets;
+    offsets.resize(sectionCount);
+    std::size_t indexBytes = m_indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+    for (GLsizei i = 0; i < sectionCount; i++) {
+        offsets[i] =
+            reinterpret_cast<const GLvoid *>(firstIndices[i] * indexBytes);
+    }
+    glCheck(glMultiDrawElementsBaseVertex(drawMode, counts, m_indexType,
+                                          offsets.data(), sectionCount,
+                                          baseVertices));
+    drawCalls++;
+}
+
+void Drawable::drawSectionsIndirect(std::size_t offset, GLsizei sectionCount,
+                                    GLenum drawMode) const
+{
+    auto multiDrawElementsIndirect = getMultiDrawElementsIndirect();
+    glCheck(multiDrawElementsIndirect(drawMode, m_indexType,
+                                      reinterpret_cast<const GLvoid *>(offset),
+                                      sectionCount, 0));
+    drawCalls++;
+}
+
+GLuint Drawable::getHandle() const
+{
+    return m_handle;
+}
+
+GLsizei Drawable::getIndicesCount() const
+{
+    return m_indicesCount;
+}
+
+GLenum Drawable::getIndexType() const
+{
+    return m_indexType;
 }
 
 //
 //  Vertex array
 //
-VertexArray::VertexArray()
-{
-    glCheck(glGenVertexArrays(1, &m_handle));
-}
+VertexArray::VertexArray() = default;
 
 VertexArray::~VertexArray()
 {
@@ -68,8 +161,12 @@ VertexArray &VertexArray::operator=(VertexArray &&other)
 {
     destroy();
     m_bufferObjects = std::move(other.m_bufferObjects);
+    m_bufferCapacities = std::move(other.m_bufferCapacities);
+    m_instanceAttributes = std::move(other.m_instanceAttributes);
+    m_attributeCount = other.m_attributeCount;
     m_handle = other.m_handle;
     m_indicesCount = other.m_indicesCount;
+    m_indexType = other.m_indexType;
     other.reset();
     return *this;
 }
@@ -78,24 +175,29 @@ void VertexArray::create()
 {
     if (!m_handle) {
         glCheck(glGenVertexArrays(1, &m_handle));
+        createdObjects++;
     }
 }
 
 void VertexArray::destroy()
 {
-    glCheck(glDeleteVertexArrays(1, &m_handle));
-    glCheck(glDeleteBuffers(m_bufferObjects.size(), m_bufferObjects.data()));
+    if (m_handle) {
+        gl::forgetVertexArray(m_handle);
+        glCheck(glDeleteVertexArrays(1, &m_handle));
+        glCheck(
+            glDeleteBuffers(m_bufferObjects.size(), m_bufferObjects.data()));
+    }
     reset();
 }
 
 void VertexArray::bind() const
 {
-    glCheck(glBindVertexArray(m_handle));
+    gl::bindVertexArray(m_handle);
 }
 
 Drawable VertexArray::getDrawable() const
 {
-    return {m_handle, m_indicesCount};
+    return {m_handle, m_indicesCount, m_indexType};
 }
 
 void VertexArray::addVertexBuffer(int magnitude,
@@ -104,9 +206,8 @@ void VertexArray::addVertexBuffer(int magnitude,
     bind();
     GLuint vertexBuffer = genVbo();
     bufferData(data);
-    vertexAttribPointer(m_bufferObjects.size(), magnitude, GL_UNSIGNED_INT);
-    glCheck(glEnableVertexAttribArray(m_bufferObjects.size()));
-    m_bufferObjects.push_back(vertexBuffer);
+    addAttribute(magnitude, GL_UNSIGNED_INT);
+    addBufferObject(vertexBuffer, data.size() * sizeof(data[0]));
 }
 
 void VertexArray::addVertexBuffer(int magnitude,
@@ -115,9 +216,19 @@ void VertexArray::addVertexBuffer(int magnitude,
     bind();
     GLuint vertexBuffer = genVbo();
     bufferData(data);
-    vertexAttribPointer(m_bufferObjects.size(), magnitude, GL_FLOAT);
-    glCheck(glEnableVertexAttribArray(m_bufferObjects.size()));
-    m_bufferObjects.push_back(vertexBuffer);
+    addAttribute(magnitude, GL_FLOAT);
+    addBufferObject(vertexBuffer, data.size() * sizeof(data[0]));
+}
+
+void VertexArray::addInterleavedBuffer(
+    const std::vector<VertexAttribute> &layout, GLsizei stride,
+    const void *data, std::size_t bytes)
+{
+    bind();
+    GLuint vertexBuffer = genVbo();
+    glCheck(glBufferData(GL_ARRAY_BUFFER, bytes, data, GL_STATIC_DRAW));
+    addLayout(layout, stride);
+    addBufferObject(vertexBuffer, bytes);
 }
 
 void VertexArray::addIndexBuffer(const std::vector<GLuint> &indices)
@@ -126,21 +237,169 @@ void VertexArray::addIndexBuffer(const std::vector<GLuint> &indices)
 
     GLuint elementBuffer;
     glCheck(glGenBuffers(1, &elementBuffer));
+    createdObjects++;
     glCheck(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer));
 
     glCheck(glBufferData(GL_ELEMENT_ARRAY_BUFFER,
                          indices.size() * sizeof(GLuint), indices.data(),
                          GL_STATIC_DRAW));
 
-    m_bufferObjects.push_back(elementBuffer);
+    addBufferObject(elementBuffer, indices.size() * sizeof(GLuint));
     m_indicesCount = indices.size();
+    m_indexType = GL_UNSIGNED_INT;
+}
+
+void VertexArray::addSharedVertexBuffer(
+    const std::vector<VertexAttribute> &layout, GLsizei stride, GLuint buffer)
+{
+    bind();
+    glCheck(glBindBuffer(GL_ARRAY_BUFFER, buffer));
+    addLayout(layout, stride);
+}
+
+void VertexArray::addSharedIndexBuffer(GLuint buffer, GLenum indexType)
+{
+    bind();
+    glCheck(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer));
+    m_indicesCount = 0;
+    m_indexType = indexType;
+}
+
+void VertexArray::addSharedVertexBuffer(int magnitude, GLuint buffer)
+{
+    bind();
+    glCheck(glBindBuffer(GL_ARRAY_BUFFER, buffer));
+    addAttribute(magnitude, GL_FLOAT);
+}
+
+void VertexArray::addInstanceBuffer(int magnitude,
+                                    const std::vector<GLuint> &data)
+{
+    bind();
+    InstanceAttribute attribute{m_attributeCount++, genVbo(), magnitude,
+                                GL_UNSIGNED_INT};
+    bufferData(data);
+    instanceAttribPointer(attribute, 0);
+    glCheck(glEnableVertexAttribArray(attribute.index));
+    glCheck(glVertexAttribDivisor(attribute.index, 1));
+    addBufferObject(attribute.buffer, data.size() * sizeof(data[0]));
+    m_instanceAttributes.push_back(attribute);
+}
+
+void VertexArray::addInstanceBuffer(int magnitude,
+                                    const std::vector<GLfloat> &data)
+{
+    bind();
+    InstanceAttribute attribute{m_attributeCount++, genVbo(), magnitude,
+                                GL_FLOAT};
+    bufferData(data);
+    instanceAttribPointer(attribute, 0);
+    glCheck(glEnableVertexAttribArray(attribute.index));
+    glCheck(glVertexAttribDivisor(attribute.index, 1));
+    addBufferObject(attribute.buffer, data.size() * sizeof(data[0]));
+    m_instanceAttributes.push_back(attribute);
+}
+
+void VertexArray::updateBuffer(std::size_t buffer, const void *data,
+                               std::size_t bytes, std::size_t firstChanged)
+{
+    glCheck(glBindBuffer(GL_ARRAY_BUFFER, m_bufferObjects[buffer]));
+    std::size_t &capacity = m_bufferCapacities[buffer];
+    if (bytes > capacity) {
+        // Grown geometrically, so text that keeps getting longer does not
+        // reallocate every time. The old contents are lost
+        capacity = std::max(bytes, capacity * 2);
+        glCheck(glBufferData(GL_ARRAY_BUFFER, capacity, nullptr,
+                             GL_DYNAMIC_DRAW));
+        firstChanged = 0;
+    }
+    if (firstChanged < bytes) {
+        glCheck(glBufferSubData(GL_ARRAY_BUFFER, firstChanged,
+                                bytes - firstChanged,
+                                static_cast<const std::uint8_t *>(data) +
+                                    firstChanged));
+    }
+}
+
+void VertexArray::setFirstInstance(GLuint instance)
+{
+    bind();
+    for (auto &attribute : m_instanceAttributes) {
+        instanceAttribPointer(attribute, instance);
+    }
+}
+
+void VertexArray::addBufferObject(GLuint buffer, std::size_t bytes)
+{
+    m_bufferObjects.push_back(buffer);
+    m_bufferCapacities.push_back(bytes);
+}
+
+void VertexArray::addLayout(const std::vector<VertexAttribute> &layout,
+                            GLsizei stride)
+{
+    std::size_t offset = 0;
+    for (auto &attribute : layout) {
+        auto pointer = reinterpret_cast<const GLvoid *>(offset);
+        if (attribute.integer) {
+            glCheck(glVertexAttribIPointer(m_attributeCount,
+                                           attribute.magnitude, attribute.type,
+                                           stride, pointer));
+        }
+        else {
+            glCheck(glVertexAttribPointer(
+                m_attributeCount, attribute.magnitude, attribute.type,
+                attribute.normalized ? GL_TRUE : GL_FALSE, stride, pointer));
+        }
+        glCheck(glEnableVertexAttribArray(m_attributeCount));
+        m_attributeCount++;
+        offset += attributeBytes(attribute);
+    }
+}
+
+void VertexArray::addAttribute(int magnitude, GLenum type)
+{
+    vertexAttribPointer(m_attributeCount, magnitude, type);
+    glCheck(glEnableVertexAttribArray(m_attributeCount));
+    m_attributeCount++;
+}
+
+void VertexArray::instanceAttribPointer(const InstanceAttribute &attribute,
+                                        GLuint instance)
+{
+    // Every instance attribute is 4 bytes per component
+    auto offset = reinterpret_cast<const GLvoid *>(
+        static_cast<std::size_t>(instance) * attribute.magnitude * 4);
+    glCheck(glBindBuffer(GL_ARRAY_BUFFER, attribute.buffer));
+    if (attribute.type == GL_FLOAT) {
+        glCheck(glVertexAttribPointer(attribute.index, attribute.magnitude,
+                                      GL_FLOAT, GL_FALSE, 0, offset));
+    }
+    else {
+        glCheck(glVertexAttribIPointer(attribute.index, attribute.magnitude,
+                                       attribute.type, 0, offset));
+    }
 }
 
 void VertexArray::reset()
 {
     m_bufferObjects.clear();
+    m_bufferCapacities.clear();
+    m_instanceAttributes.clear();
+    m_attributeCount = 0;
     m_handle = 0;
     m_indicesCount = 0;
+    m_indexType = GL_UNSIGNED_INT;
+}
+
+std::size_t getCreatedObjectCount()
+{
+    return createdObjects;
+}
+
+std::size_t getDrawCallCount()
+{
+    return drawCalls;
 }
 
 } // namespace gl
\ No newline at end of file
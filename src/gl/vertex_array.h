@@ -1,30 +1,105 @@
 #pragma once
 
+#include <cstddef>
 #include <glad/glad.h>
 #include <vector>
 
 namespace gl {
 
+/**
+ * @brief One attribute of an interleaved vertex. The attributes of a vertex
+ * are packed in the order they are given, with no gaps between them
+ */
+struct VertexAttribute {
+    GLint magnitude;
+    GLenum type;
+
+    // Integer types are read as 0 to 1 (or -1 to 1 if signed), rather than
+    // as whole numbers
+    bool normalized = false;
+
+    // Integer types are read by int or uint inputs, without being turned
+    // into floats
+    bool integer = false;
+};
+
 /**
  * @brief Minimal information for drawing with glDrawElements
  *
  */
 class Drawable final {
   public:
-    Drawable(GLuint vao, GLsizei indices);
+    Drawable(GLuint vao, GLsizei indices, GLenum indexType = GL_UNSIGNED_INT);
 
     void bindAndDraw(GLenum drawMode = GL_TRIANGLES) const;
 
     void bind() const;
     void draw(GLenum drawMode = GL_TRIANGLES) const;
 
+    // Draws only part of the indices, starting at firstIndex. The base
+    // vertex is added to every index
+    void drawSection(GLsizei firstIndex, GLsizei count, GLint baseVertex = 0,
+                     GLenum drawMode = GL_TRIANGLES) const;
+
+    // Draws the first vertices of the vertex buffers once for each instance,
+    // without using the indices
+    void drawInstances(GLsizei vertexCount, GLsizei instanceCount,
+                       GLenum drawMode = GL_TRIANGLE_STRIP) const;
+
+    /**
+     * @brief Draws many sections in one call, the same as calling
+     * drawSection for each of them
+     *
+     * @param firstIndices The first index of each section
+     * @param counts The number of indices in each section
+     * @param baseVertices The base vertex of each section
+     * @param sectionCount The length of each of the arrays
+     */
+    void drawSections(const GLsizei *firstIndices, const GLsizei *counts,
+                      const GLint *baseVertices, GLsizei sectionCount,
+                      GLenum drawMode = GL_TRIANGLES) const;
+
+    /**
+     * @brief Same as drawSections, but the sections are read from the bound
+     * DRAW_INDIRECT_BUFFER, as DrawElementsIndirectCommands. Only for
+     * contexts that have getMultiDrawElementsIndirect()
+     *
+     * @param offset Where the first command is in the buffer, in bytes
+     */
+    void drawSectionsIndirect(std::size_t offset, GLsizei sectionCount,
+                              GLenum drawMode = GL_TRIANGLES) const;
+
+    GLuint getHandle() const;
+    GLsizei getIndicesCount() const;
+    GLenum getIndexType() const;
+
   private:
     const GLuint m_handle = 0;
     const GLsizei m_indicesCount = 0;
+    const GLenum m_indexType = GL_UNSIGNED_INT;
 };
 
 /**
- * @brief Wrapper for an OpenGL vertex array object (aka VAO)
+ * @brief Something drawn from a vertex array that can move after a draw of
+ * it is recorded, such as a range of a buffer that gets compacted. Whatever
+ * records the draw asks it where it is at the last moment
+ */
+class DrawSource {
+  public:
+    virtual Drawable getDrawable() const = 0;
+    virtual GLint getBaseVertex() const = 0;
+
+    // Given to the shader through the draw id attribute while the source is
+    // drawn, so it can tell sources apart
+    virtual GLuint getDrawId() const = 0;
+
+  protected:
+    ~DrawSource() = default;
+};
+
+/**
+ * @brief Wrapper for an OpenGL vertex array object (aka VAO). Nothing is made
+ * until create() is called, so unused vertex arrays cost no GL objects
  */
 class VertexArray final {
   public:
@@ -45,13 +120,96 @@ class VertexArray final {
 
     void addVertexBuffer(int magnitude, const std::vector<GLuint> &data);
     void addVertexBuffer(int magnitude, const std::vector<GLfloat> &data);
+
+    /**
+     * @brief Adds a buffer of interleaved vertices, with one attribute for
+     * each entry of the layout
+     */
+    template <typename Vertex>
+    void addVertexBuffer(const std::vector<VertexAttribute> &layout,
+                         const std::vector<Vertex> &vertices)
+    {
+        addInterleavedBuffer(layout, sizeof(Vertex), vertices.data(),
+                             vertices.size() * sizeof(Vertex));
+    }
+    void addInterleavedBuffer(const std::vector<VertexAttribute> &layout,
+                              GLsizei stride, const void *data,
+                              std::size_t bytes);
     void addIndexBuffer(const std::vector<GLuint> &indices);
 
+    // Reads vertices from a buffer that something else owns, so is not
+    // deleted with this vertex array
+    void addSharedVertexBuffer(int magnitude, GLuint buffer);
+    void addSharedVertexBuffer(const std::vector<VertexAttribute> &layout,
+                               GLsizei stride, GLuint buffer);
+
+    // Same as addSharedVertexBuffer, but for indices. As the number of
+    // indices is not known, only Drawable::drawSection can draw them
+    void addSharedIndexBuffer(GLuint buffer, GLenum indexType);
+
+    /**
+     * @brief Adds a buffer that steps forward once per instance rather than
+     * once per vertex. Unsigned data is read as integers by the shader
+     */
+    void addInstanceBuffer(int magnitude, const std::vector<GLuint> &data);
+    void addInstanceBuffer(int magnitude, const std::vector<GLfloat> &data);
+
+    /**
+     * @brief Makes instance 0 of the next draw read the instance buffers
+     * from this instance onwards. Stands in for the base instance of later
+     * OpenGL versions
+     */
+    void setFirstInstance(GLuint instance);
+
+    /**
+     * @brief Replaces the contents of a buffer, only sending what changed.
+     * The buffer grows if the data does not fit
+     *
+     * @param buffer Which buffer, in the order they were added
+     * @param bytes The size of the new contents
+     * @param firstChanged The first byte that differs from the old contents.
+     * Everything before it is assumed to be on the GPU already
+     */
+    void updateBuffer(std::size_t buffer, const void *data, std::size_t bytes,
+                      std::size_t firstChanged = 0);
+
+    template <typename T>
+    void updateBuffer(std::size_t buffer, const std::vector<T> &data,
+                      std::size_t firstChanged = 0)
+    {
+        updateBuffer(buffer, data.data(), data.size() * sizeof(T),
+                     firstChanged * sizeof(T));
+    }
+
   private:
+    struct InstanceAttribute {
+        GLuint index;
+        GLuint buffer;
+        int magnitude;
+        GLenum type;
+    };
+
+    void addBufferObject(GLuint buffer, std::size_t bytes);
+    void addLayout(const std::vector<VertexAttribute> &layout, GLsizei stride);
+    void addAttribute(int magnitude, GLenum type);
+    void instanceAttribPointer(const InstanceAttribute &attribute,
+                               GLuint instance);
     void reset();
 
     std::vector<GLuint> m_bufferObjects;
+    std::vector<std::size_t> m_bufferCapacities;
+    std::vector<InstanceAttribute> m_instanceAttributes;
+    GLuint m_attributeCount = 0;
     GLuint m_handle = 0;
     GLsizei m_indicesCount = 0;
+    GLenum m_indexType = GL_UNSIGNED_INT;
 };
+
+// Vertex arrays and buffers made since the program started, for finding code
+// that makes them every frame
+std::size_t getCreatedObjectCount();
+
+// Draw calls made through Drawable since the program started
+std::size_t getDrawCallCount();
+
 } // namespace gl
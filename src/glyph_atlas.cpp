@@ -0,0 +1,206 @@
+#include "glyph_atlas.h"
+
+#include <algorithm>
+
+namespace {
+constexpr unsigned MIN_ATLAS_SIZE = 128;
+
+// Empty space around each glyph, so that sampling just outside of one never
+// picks up its neighbours
+constexpr unsigned GLYPH_PADDING = 1;
+
+bool usesMipmaps(GLenum minFilter)
+{
+    return minFilter == GL_NEAREST_MIPMAP_NEAREST ||
+           minFilter == GL_LINEAR_MIPMAP_NEAREST ||
+           minFilter == GL_NEAREST_MIPMAP_LINEAR ||
+           minFilter == GL_LINEAR_MIPMAP_LINEAR;
+}
+} // namespace
+
+void GlyphAtlas::create(unsigned channels, unsigned maxSize)
+{
+    m_channels = channels;
+    m_maxSize = maxSize;
+    m_size = std::min(MIN_ATLAS_SIZE, m_maxSize);
+    m_pixels.assign(m_size * m_size * m_channels, 0);
+    m_packer.reset(m_size, m_size);
+    m_dirtyLeft = m_dirtyTop = m_dirtyRight = m_dirtyBottom = 0;
+    markDirty(0, 0, m_size, m_size);
+}
+
+void GlyphAtlas::load(unsigned size, const std::uint8_t *pixels,
+                      const std::vector<sf::IntRect> &rects)
+{
+    m_size = size;
+    m_maxSize = std::max(m_maxSize, m_size);
+    m_pixels.assign(pixels, pixels + m_size * m_size * m_channels);
+    m_packer.reset(m_size, m_size);
+    for (auto &rect : rects) {
+        m_packer.reserve(static_cast<unsigned>(rect.left) - GLYPH_PADDING,
+                         static_cast<unsigned>(rect.top) - GLYPH_PADDING,
+                         static_cast<unsigned>(rect.width) + GLYPH_PADDING * 2,
+                         static_cast<unsigned>(rect.height) +
+                             GLYPH_PADDING * 2);
+    }
+    m_dirtyLeft = m_dirtyTop = m_dirtyRight = m_dirtyBottom = 0;
+    markDirty(0, 0, m_size, m_size);
+}
+
+bool GlyphAtlas::canFit(unsigned width, unsigned height, unsigned maxSize)
+{
+    return width + GLYPH_PADDING * 2 <= maxSize &&
+           height + GLYPH_PADDING * 2 <= maxSize;
+}
+
+bool GlyphAtlas::add(const std::uint8_t *pixels, unsigned width,
+                     unsigned height, sf::Vector2u &position)
+{
+    unsigned paddedWidth = width + GLYPH_PADDING * 2;
+    unsigned paddedHeight = height + GLYPH_PADDING * 2;
+    while (!m_packer.pack(paddedWidth, paddedHeight, position)) {
+        if (m_size * 2 > m_maxSize) {
+            return false;
+        }
+        grow();
+    }
+    position.x += GLYPH_PADDING;
+    position.y += GLYPH_PADDING;
+
+    std::size_t rowBytes = width * m_channels;
+    for (unsigned y = 0; y < height; y++) {
+        std::copy_n(pixels + y * rowBytes, rowBytes,
+                    m_pixels.data() +
+                        ((position.y + y) * m_size + position.x) * m_channels);
+    }
+    markDirty(position.x, position.y, width, height);
+    return true;
+}
+
+void GlyphAtlas::upload()
+{
+    if (m_dirtyLeft >= m_dirtyRight || m_dirtyTop >= m_dirtyBottom) {
+        return;
+    }
+
+    std::size_t bytes = 0;
+    auto format =
+        m_channels == 3 ? gl::TextureFormat::RGB8 : gl::TextureFormat::R8;
+    if (!m_texture) {
+        m_texture = std::make_unique<gl::Texture2d>();
+    }
+    if (m_textureSize != m_size) {
+        // Growing needs new storage, so this is the only time the whole image
+        // is sent
+        m_texture->create(m_size, m_size, m_pixels.data(), format);
+        m_texture->setFilters(m_minFilter, m_magFilter);
+        m_textureSize = m_size;
+        bytes = m_pixels.size();
+    }
+    else {
+        unsigned width = m_dirtyRight - m_dirtyLeft;
+        unsigned height = m_dirtyBottom - m_dirtyTop;
+        m_texture->update(m_dirtyLeft, m_dirtyTop, width, height, m_size,
+                         m_pixels.data() +
+                             (m_dirtyTop * m_size + m_dirtyLeft) * m_channels,
+                         format);
+        bytes = static_cast<std::size_t>(width) * height * m_channels;
+
+        // Once for all that changed, and only if the mipmaps are sampled
+        if (usesMipmaps(m_minFilter)) {
+            m_texture->generateMipmaps();
+        }
+    }
+    m_uploadedBytes += bytes;
+    m_totalUploadedBytes += bytes;
+    m_dirtyLeft = m_dirtyTop = m_dirtyRight = m_dirtyBottom = 0;
+}
+
+void GlyphAtlas::resetUploadedBytes()
+{
+    m_uploadedBytes = 0;
+}
+
+void GlyphAtlas::setFilters(GLenum minFilter, GLenum magFilter)
+{
+    m_minFilter = minFilter;
+    m_magFilter = magFilter;
+    if (m_texture) {
+        m_texture->setFilters(m_minFilter, m_magFilter);
+    }
+}
+
+void GlyphAtlas::bind() const
+{
+    if (m_texture) {
+        m_texture->bind();
+    }
+}
+
+const gl::Texture2d *GlyphAtlas::getTexture() const
+{
+    return m_texture.get();
+}
+
+unsigned GlyphAtlas::getSize() const
+{
+    return m_size;
+}
+
+unsigned GlyphAtlas::getChannels() const
+{
+    return m_channels;
+}
+
+const std::uint8_t *GlyphAtlas::getPixels() const
+{
+    return m_pixels.data();
+}
+
+float GlyphAtlas::getFillRatio() const
+{
+    return m_packer.getFillRatio();
+}
+
+std::size_t GlyphAtlas::getUploadedBytes() const
+{
+    return m_uploadedBytes;
+}
+
+std::size_t GlyphAtlas::getTotalUploadedBytes() const
+{
+    return m_totalUploadedBytes;
+}
+
+void GlyphAtlas::grow()
+{
+    // Rows are copied across at the same position, so nothing that is
+    // already in the atlas has to be packed again
+    unsigned size = m_size * 2;
+    std::vector<std::uint8_t> pixels(size * size * m_channels, 0);
+    std::size_t rowBytes = m_size * m_channels;
+    for (unsigned y = 0; y < m_size; y++) {
+        std::copy_n(m_pixels.data() + y * rowBytes, rowBytes,
+                    pixels.data() + y * size * m_channels);
+    }
+    m_pixels = std::move(pixels);
+    m_size = size;
+    m_packer.grow(m_size, m_size);
+    markDirty(0, 0, m_size, m_size);
+}
+
+void GlyphAtlas::markDirty(unsigned x, unsigned y, unsigned width,
+                           unsigned height)
+{
+    if (m_dirtyLeft >= m_dirtyRight || m_dirtyTop >= m_dirtyBottom) {
+        m_dirtyLeft = x;
+        m_dirtyTop = y;
+        m_dirtyRight = x + width;
+        m_dirtyBottom = y + height;
+        return;
+    }
+    m_dirtyLeft = std::min(m_dirtyLeft, x);
+    m_dirtyTop = std::min(m_dirtyTop, y);
+    m_dirtyRight = std::max(m_dirtyRight, x + width);
+    m_dirtyBottom = std::max(m_dirtyBottom, y + height);
+}
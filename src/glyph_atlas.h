@@ -0,0 +1,111 @@
+#pragma once
+
+#include "atlas_packer.h"
+#include "gl/textures.h"
+
+#include <SFML/Graphics/Rect.hpp>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief A texture of glyph images. The images are kept in CPU memory as
+ * well, and only the area that has changed since the last upload is sent to
+ * the GPU. Nothing touches OpenGL until the first upload, so an atlas can be
+ * filled on a thread without a context
+ */
+class GlyphAtlas final {
+  public:
+    /**
+     * @brief Clears the atlas
+     *
+     * @param channels The number of bytes per pixel, 1 or 3
+     * @param maxSize The largest the atlas may grow to
+     */
+    void create(unsigned channels, unsigned maxSize);
+
+    /**
+     * @brief Replaces the whole atlas with a ready made image
+     *
+     * @param size The width and height of the image
+     * @param pixels The image, which is copied
+     * @param rects The areas of the image that are already used by glyphs
+     */
+    void load(unsigned size, const std::uint8_t *pixels,
+              const std::vector<sf::IntRect> &rects);
+
+    /**
+     * @brief Places a glyph image in the atlas, growing the atlas if there is
+     * no room left. Nothing already in the atlas is moved, though the texture
+     * coordinates of everything change when it grows
+     *
+     * @param pixels The image, with tightly packed rows
+     * @param width The width of the image
+     * @param height The height of the image
+     * @param position Set to the top left of the image in the atlas
+     * @return true The image was added
+     * @return false The atlas is full and cannot grow any more
+     */
+    bool add(const std::uint8_t *pixels, unsigned width, unsigned height,
+             sf::Vector2u &position);
+
+    // Whether an image this size, with its padding, fits in an atlas that
+    // can grow to maxSize at all
+    static bool canFit(unsigned width, unsigned height, unsigned maxSize);
+
+    /**
+     * @brief Sends everything that changed since the last call to the GPU
+     */
+    void upload();
+
+    /**
+     * @brief Starts counting uploaded bytes from zero again, for example at
+     * the start of a frame
+     */
+    void resetUploadedBytes();
+
+    void setFilters(GLenum minFilter, GLenum magFilter);
+    void bind() const;
+
+    // The texture on the GPU, or nullptr before the first upload
+    const gl::Texture2d *getTexture() const;
+
+    unsigned getSize() const;
+    unsigned getChannels() const;
+    const std::uint8_t *getPixels() const;
+
+    float getFillRatio() const;
+
+    // Bytes sent since the last resetUploadedBytes(), and in total
+    std::size_t getUploadedBytes() const;
+    std::size_t getTotalUploadedBytes() const;
+
+  private:
+    void grow();
+    void markDirty(unsigned x, unsigned y, unsigned width, unsigned height);
+
+    SkylinePacker m_packer;
+    std::unique_ptr<gl::Texture2d> m_texture;
+    std::vector<std::uint8_t> m_pixels;
+
+    unsigned m_size = 0;
+    unsigned m_maxSize = 0;
+    unsigned m_channels = 1;
+
+    // The size of the texture on the GPU, which lags behind m_size until the
+    // next upload
+    unsigned m_textureSize = 0;
+
+    // The area that has changed since the last upload, empty when
+    // m_dirtyLeft >= m_dirtyRight
+    unsigned m_dirtyLeft = 0;
+    unsigned m_dirtyTop = 0;
+    unsigned m_dirtyRight = 0;
+    unsigned m_dirtyBottom = 0;
+
+    GLenum m_minFilter = GL_LINEAR_MIPMAP_LINEAR;
+    GLenum m_magFilter = GL_NEAREST;
+
+    std::size_t m_uploadedBytes = 0;
+    std::size_t m_totalUploadedBytes = 0;
+};
@@ -0,0 +1,374 @@
+#include "glyph_buffer.h"
+
+#include "gl/gl_errors.h"
+#include "gl/primitive.h"
+#include "text.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <utility>
+
+namespace {
+constexpr std::size_t QUAD_BYTES = sizeof(TextVertex) * 4;
+constexpr std::size_t QUAD_ID_BYTES = sizeof(GLushort) * 4;
+constexpr std::size_t TRANSFORM_FLOATS = 16;
+
+// A vertex holds the low 16 bits of its block, and the draw id the rest
+constexpr unsigned BLOCKS_PER_DRAW_ID = 0x10000;
+
+const std::vector<gl::VertexAttribute> TRANSFORM_ID_LAYOUT = {
+    {1, GL_UNSIGNED_SHORT, false, true},
+};
+
+GLuint createBuffer(std::size_t bytes)
+{
+    GLuint buffer;
+    glCheck(glGenBuffers(1, &buffer));
+    glCheck(glBindBuffer(GL_COPY_WRITE_BUFFER, buffer));
+    glCheck(glBufferData(GL_COPY_WRITE_BUFFER, bytes, nullptr,
+                         GL_DYNAMIC_DRAW));
+    return buffer;
+}
+
+void copyQuads(GLuint from, GLuint to, std::size_t quadBytes,
+               std::size_t fromQuad, std::size_t toQuad, std::size_t quadCount)
+{
+    glCheck(glBindBuffer(GL_COPY_READ_BUFFER, from));
+    glCheck(glBindBuffer(GL_COPY_WRITE_BUFFER, to));
+    glCheck(glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                                fromQuad * quadBytes, toQuad * quadBytes,
+                                quadCount * quadBytes));
+}
+} // namespace
+
+//
+//  Glyph range
+//
+GlyphRange::GlyphRange(GlyphBuffer *buffer, unsigned block)
+    : m_buffer(buffer)
+    , m_block(block)
+{
+}
+
+GlyphRange::~GlyphRange()
+{
+    release();
+}
+
+GlyphRange::GlyphRange(GlyphRange &&other)
+{
+    *this = std::move(other);
+}
+
+GlyphRange &GlyphRange::operator=(GlyphRange &&other)
+{
+    release();
+    m_buffer = other.m_buffer;
+    m_block = other.m_block;
+    other.m_buffer = nullptr;
+    return *this;
+}
+
+bool GlyphRange::isValid() const
+{
+    return m_buffer != nullptr;
+}
+
+std::size_t GlyphRange::getQuadCapacity() const
+{
+    return m_buffer ? m_buffer->m_blocks[m_block].quadCount : 0;
+}
+
+gl::Drawable GlyphRange::getDrawable() const
+{
+    return m_buffer ? m_buffer->getDrawable() : gl::Drawable(0, 0);
+}
+
+GLuint GlyphRange::getDrawId() const
+{
+    return m_block / BLOCKS_PER_DRAW_ID;
+}
+
+GLint GlyphRange::getBaseVertex() const
+{
+    return m_buffer ? static_cast<GLint>(
+                          m_buffer->m_blocks[m_block].firstQuad * 4)
+                    : 0;
+}
+
+void GlyphRange::write(const TextVertex *vertices, std::size_t quadCount,
+                       std::size_t firstQuad)
+{
+    if (m_buffer && firstQuad < quadCount) {
+        m_buffer->write(m_block, vertices + firstQuad * 4,
+                        (quadCount - firstQuad) * QUAD_BYTES,
+                        firstQuad * QUAD_BYTES);
+    }
+}
+
+void GlyphRange::setTransform(const glm::mat4 &modelMatrix)
+{
+    if (m_buffer) {
+        m_buffer->setTransform(m_block, modelMatrix);
+    }
+}
+
+void GlyphRange::release()
+{
+    if (m_buffer) {
+        m_buffer->free(m_block);
+        m_buffer = nullptr;
+    }
+}
+
+//
+//  Glyph buffer
+//
+GlyphBuffer::~GlyphBuffer()
+{
+    destroy();
+}
+
+void GlyphBuffer::create(std::size_t quadCapacity)
+{
+    destroy();
+    relocate(quadCapacity);
+}
+
+void GlyphBuffer::destroy()
+{
+    assert(m_liveQuads == 0 && "Glyph ranges outlived their buffer");
+    if (m_buffer) {
+        glCheck(glDeleteBuffers(1, &m_buffer));
+        glCheck(glDeleteBuffers(1, &m_transformIds));
+    }
+    m_buffer = 0;
+    m_transformIds = 0;
+    m_transformData.clear();
+    m_dirtyTransforms.clear();
+    m_transforms.destroy();
+    m_quadCapacity = 0;
+    m_indexQuads = 0;
+    m_blocks.clear();
+    m_unusedBlocks.clear();
+    m_freeRanges.clear();
+    m_liveQuads = 0;
+}
+
+GlyphRange GlyphBuffer::allocate(std::size_t quadCount)
+{
+    quadCount = std::max<std::size_t>(quadCount, 1);
+    std::size_t firstQuad = 0;
+    if (!findFreeRange(quadCount, firstQuad)) {
+        // Packing the live ranges together is enough when the free space is
+        // only too scattered, otherwise the buffer has to grow as well
+        std::size_t capacity = m_quadCapacity;
+        if (m_quadCapacity - m_liveQuads < quadCount) {
+            capacity = std::max(m_quadCapacity * 2, m_liveQuads + quadCount);
+        }
+        relocate(capacity);
+        findFreeRange(quadCount, firstQuad);
+    }
+
+    unsigned block = static_cast<unsigned>(m_blocks.size());
+    if (!m_unusedBlocks.empty()) {
+        block = m_unusedBlocks.back();
+        m_unusedBlocks.pop_back();
+    }
+    else {
+        m_blocks.emplace_back();
+    }
+    m_blocks[block] = {firstQuad, quadCount, true};
+    m_liveQuads += quadCount;
+    m_transformData.resize(m_blocks.size() * TRANSFORM_FLOATS);
+    writeTransformIds(block);
+    return {this, block};
+}
+
+void GlyphBuffer::reserveIndices(std::size_t quadCount)
+{
+    if (quadCount > m_indexQuads) {
+        m_indexQuads = quadCount;
+        GLenum indexType;
+        GLuint indices = getQuadIndexBuffer(m_indexQuads, indexType);
+        m_vao.addSharedIndexBuffer(indices, indexType);
+    }
+}
+
+gl::Drawable GlyphBuffer::getDrawable() const
+{
+    return m_vao.getDrawable();
+}
+
+void GlyphBuffer::bindTransforms()
+{
+    // One upload for each run of neighbouring blocks
+    std::sort(m_dirtyTransforms.begin(), m_dirtyTransforms.end());
+    m_dirtyTransforms.erase(
+        std::unique(m_dirtyTransforms.begin(), m_dirtyTransforms.end()),
+        m_dirtyTransforms.end());
+    for (std::size_t i = 0; i < m_dirtyTransforms.size();) {
+        std::size_t end = i + 1;
+        while (end < m_dirtyTransforms.size() &&
+               m_dirtyTransforms[end] == m_dirtyTransforms[end - 1] + 1) {
+            end++;
+        }
+        m_transforms.update(m_transformData,
+                            m_dirtyTransforms[i] * TRANSFORM_FLOATS,
+                            (end - i) * TRANSFORM_FLOATS);
+        i = end;
+    }
+    m_dirtyTransforms.clear();
+    m_transforms.bind(TRANSFORM_UNIT);
+}
+
+std::size_t GlyphBuffer::getLiveBytes() const
+{
+    return m_liveQuads * (QUAD_BYTES + QUAD_ID_BYTES);
+}
+
+std::size_t GlyphBuffer::getFreeBytes() const
+{
+    return (m_quadCapacity - m_liveQuads) * (QUAD_BYTES + QUAD_ID_BYTES);
+}
+
+float GlyphBuffer::getFragmentation() const
+{
+    std::size_t freeQuads = m_quadCapacity - m_liveQuads;
+    std::size_t largest = 0;
+    for (auto &range : m_freeRanges) {
+        largest = std::max(largest, range.second);
+    }
+    return freeQuads > 0 ? 1.0f - static_cast<float>(largest) / freeQuads
+                         : 0.0f;
+}
+
+std::size_t GlyphBuffer::getCompactionCount() const
+{
+    return m_compactionCount;
+}
+
+void GlyphBuffer::free(unsigned block)
+{
+    Block &freed = m_blocks[block];
+    freed.isUsed = false;
+    m_liveQuads -= freed.quadCount;
+    m_unusedBlocks.push_back(block);
+
+    // Joined with the free ranges either side, so the free list stays as
+    // short as it can be
+    auto itr = m_freeRanges.emplace(freed.firstQuad, freed.quadCount).first;
+    auto next = std::next(itr);
+    if (next != m_freeRanges.end() &&
+        itr->first + itr->second == next->first) {
+        itr->second += next->second;
+        m_freeRanges.erase(next);
+    }
+    if (itr != m_freeRanges.begin()) {
+        auto previous = std::prev(itr);
+        if (previous->first + previous->second == itr->first) {
+            previous->second += itr->second;
+            m_freeRanges.erase(itr);
+        }
+    }
+}
+
+void GlyphBuffer::write(unsigned block, const void *data, std::size_t bytes,
+                        std::size_t offset)
+{
+    glCheck(glBindBuffer(GL_ARRAY_BUFFER, m_buffer));
+    glCheck(glBufferSubData(GL_ARRAY_BUFFER,
+                            m_blocks[block].firstQuad * QUAD_BYTES + offset,
+                            bytes, data));
+}
+
+void GlyphBuffer::writeTransformIds(unsigned block)
+{
+    // Only changes when the block is handed out or moved, and moving copies
+    // the ids along with the quads
+    auto &written = m_blocks[block];
+    auto id = static_cast<GLushort>(block % BLOCKS_PER_DRAW_ID);
+    std::vector<GLushort> ids(written.quadCount * 4, id);
+    glCheck(glBindBuffer(GL_ARRAY_BUFFER, m_transformIds));
+    glCheck(glBufferSubData(GL_ARRAY_BUFFER,
+                            written.firstQuad * QUAD_ID_BYTES,
+                            ids.size() * sizeof(GLushort), ids.data()));
+}
+
+void GlyphBuffer::setTransform(unsigned block, const glm::mat4 &modelMatrix)
+{
+    GLfloat *data = &m_transformData[block * TRANSFORM_FLOATS];
+    if (std::memcmp(data, &modelMatrix, sizeof(glm::mat4)) != 0) {
+        std::memcpy(data, &modelMatrix, sizeof(glm::mat4));
+        m_dirtyTransforms.push_back(block);
+    }
+}
+
+bool GlyphBuffer::findFreeRange(std::size_t quadCount, std::size_t &firstQuad)
+{
+    // First fit, keeping the rest of the range free
+    for (auto itr = m_freeRanges.begin(); itr != m_freeRanges.end(); itr++) {
+        if (itr->second >= quadCount) {
+            firstQuad = itr->first;
+            std::size_t rest = itr->second - quadCount;
+            m_freeRanges.erase(itr);
+            if (rest > 0) {
+                m_freeRanges.emplace(firstQuad + quadCount, rest);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void GlyphBuffer::relocate(std::size_t quadCapacity)
+{
+    GLuint buffer = createBuffer(quadCapacity * QUAD_BYTES);
+    GLuint transformIds = createBuffer(quadCapacity * QUAD_ID_BYTES);
+
+    // Live ranges are copied over in the order they were in, with no gaps
+    std::vector<Block *> used;
+    for (auto &block : m_blocks) {
+        if (block.isUsed) {
+            used.push_back(&block);
+        }
+    }
+    std::sort(used.begin(), used.end(), [](const Block *a, const Block *b) {
+        return a->firstQuad < b->firstQuad;
+    });
+    std::size_t firstQuad = 0;
+    if (m_buffer) {
+        for (auto block : used) {
+            copyQuads(m_buffer, buffer, QUAD_BYTES, block->firstQuad,
+                      firstQuad, block->quadCount);
+            copyQuads(m_transformIds, transformIds, QUAD_ID_BYTES,
+                      block->firstQuad, firstQuad, block->quadCount);
+            block->firstQuad = firstQuad;
+            firstQuad += block->quadCount;
+        }
+        glCheck(glDeleteBuffers(1, &m_buffer));
+        glCheck(glDeleteBuffers(1, &m_transformIds));
+        m_compactionCount++;
+    }
+    m_buffer = buffer;
+    m_transformIds = transformIds;
+    m_quadCapacity = quadCapacity;
+    m_freeRanges.clear();
+    if (firstQuad < quadCapacity) {
+        m_freeRanges.emplace(firstQuad, quadCapacity - firstQuad);
+    }
+
+    // The vertex array has to point at the new storage
+    m_vao.destroy();
+    m_vao.create();
+    m_vao.addSharedVertexBuffer(getTextVertexLayout(), sizeof(TextVertex),
+                                m_buffer);
+    m_vao.addSharedVertexBuffer(TRANSFORM_ID_LAYOUT, sizeof(GLushort),
+                                m_transformIds);
+    if (m_indexQuads > 0) {
+        GLenum indexType;
+        GLuint indices = getQuadIndexBuffer(m_indexQuads, indexType);
+        m_vao.addSharedIndexBuffer(indices, indexType);
+    }
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include "gl/textures.h"
+#include "gl/vertex_array.h"
+
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <map>
+#include <vector>
+
+class GlyphBuffer;
+struct TextVertex;
+
+/**
+ * @brief A range of quads in a GlyphBuffer, which is given back to the buffer
+ * when it is destroyed. The buffer must outlive its ranges
+ */
+class GlyphRange final : public gl::DrawSource {
+  public:
+    GlyphRange() = default;
+    ~GlyphRange();
+
+    GlyphRange(GlyphRange &&other);
+    GlyphRange &operator=(GlyphRange &&other);
+
+    GlyphRange(const GlyphRange &) = delete;
+    GlyphRange &operator=(const GlyphRange &) = delete;
+
+    bool isValid() const;
+    std::size_t getQuadCapacity() const;
+
+    // The vertex array of the buffer, which is made again when it grows
+    gl::Drawable getDrawable() const override;
+
+    // Where the range starts right now. Compaction moves ranges, so this is
+    // not worth keeping between frames
+    GLint getBaseVertex() const override;
+
+    // The high bits of the range's transform, as its vertices only have room
+    // for the low 16
+    GLuint getDrawId() const override;
+
+    /**
+     * @brief Writes quads into the range
+     *
+     * @param vertices The vertices of the quads, 4 for each quad
+     * @param quadCount How many quads there are, at most the capacity
+     * @param firstQuad The first quad that changed. Quads before it are not
+     * sent again
+     */
+    void write(const TextVertex *vertices, std::size_t quadCount,
+               std::size_t firstQuad = 0);
+
+    // The model matrix the range is drawn with. Every range has its own, so
+    // ranges with different matrices can still be drawn together
+    void setTransform(const glm::mat4 &modelMatrix);
+
+  private:
+    friend class GlyphBuffer;
+    GlyphRange(GlyphBuffer *buffer, unsigned block);
+
+    void release();
+
+    GlyphBuffer *m_buffer = nullptr;
+    unsigned m_block = 0;
+};
+
+/**
+ * @brief One large vertex buffer that the quads of many texts share, so all
+ * of them are drawn with the same vertex array. Texts are handed ranges of
+ * it from a free list. When no free range is large enough, the live ranges
+ * are packed together into fresh storage, which is grown if that still
+ * leaves too little room
+ *
+ * Each vertex also says which range it is in, and the model matrix of every
+ * range is kept in a buffer texture indexed by that, so a shader can find
+ * the matrix of each quad without a uniform being set between ranges
+ */
+class GlyphBuffer final {
+  public:
+    // Where the transforms are bound for the shader's "transforms" sampler
+    static constexpr GLuint TRANSFORM_UNIT = 2;
+
+    GlyphBuffer() = default;
+    ~GlyphBuffer();
+
+    GlyphBuffer(const GlyphBuffer &) = delete;
+    GlyphBuffer &operator=(const GlyphBuffer &) = delete;
+
+    GlyphBuffer(GlyphBuffer &&) = delete;
+    GlyphBuffer &operator=(GlyphBuffer &&) = delete;
+
+    // Every range handed out has to be destroyed before the buffer is
+    // destroyed or created again, as ranges point at its blocks
+    void create(std::size_t quadCapacity);
+    void destroy();
+
+    GlyphRange allocate(std::size_t quadCount);
+
+    // Makes sure the index buffer covers a range of this many quads
+    void reserveIndices(std::size_t quadCount);
+    gl::Drawable getDrawable() const;
+
+    // Sends the transforms that changed since the last call, then binds
+    // them to TRANSFORM_UNIT. Has to be called before drawing, once the
+    // ranges' transforms are set
+    void bindTransforms();
+
+    // Bytes handed out to ranges, and bytes free between them
+    std::size_t getLiveBytes() const;
+    std::size_t getFreeBytes() const;
+
+    // How much of the free space is not in the largest free range, between
+    // 0 and 1. High values mean allocations may fail for lack of a large
+    // enough range even though there is room in total
+    float getFragmentation() const;
+    std::size_t getCompactionCount() const;
+
+  private:
+    friend class GlyphRange;
+
+    struct Block {
+        std::size_t firstQuad = 0;
+        std::size_t quadCount = 0;
+        bool isUsed = false;
+    };
+
+    void free(unsigned block);
+    void write(unsigned block, const void *data, std::size_t bytes,
+               std::size_t offset);
+    void writeTransformIds(unsigned block);
+    void setTransform(unsigned block, const glm::mat4 &modelMatrix);
+    bool findFreeRange(std::size_t quadCount, std::size_t &firstQuad);
+    void relocate(std::size_t quadCapacity);
+
+    gl::VertexArray m_vao;
+    GLuint m_buffer = 0;
+
+    // The low 16 bits of the block of the range each vertex is in, which is
+    // its transform. Ranges are drawn with the rest as their draw id
+    GLuint m_transformIds = 0;
+
+    // 16 floats for each block, and the blocks changed since the last upload
+    std::vector<GLfloat> m_transformData;
+    std::vector<unsigned> m_dirtyTransforms;
+    gl::BufferTexture m_transforms;
+    std::size_t m_quadCapacity = 0;
+    std::size_t m_indexQuads = 0;
+
+    std::vector<Block> m_blocks;
+    std::vector<unsigned> m_unusedBlocks;
+
+    // Free ranges, keyed by their first quad, mapping to their length
+    std::map<std::size_t, std::size_t> m_freeRanges;
+
+    std::size_t m_liveQuads = 0;
+    std::size_t m_compactionCount = 0;
+};
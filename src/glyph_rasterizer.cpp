@@ -0,0 +1,134 @@
+#include "glyph_rasterizer.h"
+
+#include "mapped_file.h"
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+
+GlyphRasterizer::~GlyphRasterizer()
+{
+    close();
+}
+
+bool GlyphRasterizer::loadFromFile(const std::string &fontFile)
+{
+    auto fontData = mapSharedFile(fontFile);
+    if (!fontData || !loadFromMemory(std::move(fontData))) {
+        std::cerr << "Could not load: " << fontFile << '\n';
+        return false;
+    }
+    return true;
+}
+
+bool GlyphRasterizer::loadFromMemory(
+    std::shared_ptr<const MappedFile> fontData)
+{
+    close();
+    if (!fontData) {
+        return false;
+    }
+    if (FT_Init_FreeType(&m_library) != 0) {
+        std::cerr << "Could not initialise FreeType\n";
+        m_library = nullptr;
+        return false;
+    }
+    // FreeType reads from the memory for as long as the face is open
+    if (FT_New_Memory_Face(m_library, fontData->getData(),
+                           static_cast<FT_Long>(fontData->getSize()), 0,
+                           &m_face) != 0) {
+        m_face = nullptr;
+        close();
+        return false;
+    }
+    FT_Select_Charmap(m_face, FT_ENCODING_UNICODE);
+    m_fontData = std::move(fontData);
+    return true;
+}
+
+void GlyphRasterizer::close()
+{
+    if (m_face) {
+        FT_Done_Face(m_face);
+        m_face = nullptr;
+    }
+    if (m_library) {
+        FT_Done_FreeType(m_library);
+        m_library = nullptr;
+    }
+    m_fontData.reset();
+}
+
+bool GlyphRasterizer::isOpen() const
+{
+    return m_face != nullptr;
+}
+
+void GlyphRasterizer::setPixelSize(unsigned size)
+{
+    if (m_face) {
+        FT_Set_Pixel_Sizes(m_face, 0, size);
+    }
+}
+
+GlyphBitmap GlyphRasterizer::rasterize(std::uint32_t codepoint)
+{
+    GlyphBitmap glyph;
+    if (!m_face || FT_Load_Char(m_face, codepoint,
+                                FT_LOAD_TARGET_NORMAL | FT_LOAD_FORCE_AUTOHINT |
+                                    FT_LOAD_RENDER) != 0) {
+        return glyph;
+    }
+
+    FT_GlyphSlot slot = m_face->glyph;
+    const FT_Bitmap &bitmap = slot->bitmap;
+    glyph.width = bitmap.width;
+    glyph.height = bitmap.rows;
+    glyph.left = static_cast<float>(slot->bitmap_left);
+    glyph.top = -static_cast<float>(slot->bitmap_top);
+    glyph.advance = static_cast<float>(slot->metrics.horiAdvance) / 64.0f;
+
+    // Rows can be padded wider than the bitmap, so copy row by row
+    glyph.pixels.resize(glyph.width * glyph.height);
+    for (unsigned y = 0; y < glyph.height; y++) {
+        const unsigned char *row =
+            bitmap.buffer + static_cast<std::ptrdiff_t>(y) * bitmap.pitch;
+        std::copy(row, row + glyph.width,
+                  glyph.pixels.data() + y * glyph.width);
+    }
+    return glyph;
+}
+
+float GlyphRasterizer::getAdvance(std::uint32_t codepoint)
+{
+    if (!m_face || FT_Load_Char(m_face, codepoint,
+                                FT_LOAD_TARGET_NORMAL |
+                                    FT_LOAD_FORCE_AUTOHINT) != 0) {
+        return 0;
+    }
+    return static_cast<float>(m_face->glyph->metrics.horiAdvance) / 64.0f;
+}
+
+float GlyphRasterizer::getKerning(std::uint32_t before,
+                                  std::uint32_t next) const
+{
+    if (!m_face || !FT_HAS_KERNING(m_face) || before == 0 || next == 0) {
+        return 0;
+    }
+    FT_Vector kerning;
+    FT_Get_Kerning(m_face, FT_Get_Char_Index(m_face, before),
+                   FT_Get_Char_Index(m_face, next), FT_KERNING_DEFAULT,
+                   &kerning);
+    return static_cast<float>(kerning.x) / 64.0f;
+}
+
+float GlyphRasterizer::getLineHeight() const
+{
+    if (!m_face) {
+        return 0;
+    }
+    return static_cast<float>(m_face->size->metrics.height) / 64.0f;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class MappedFile;
+
+struct FT_LibraryRec_;
+struct FT_FaceRec_;
+
+/**
+ * @brief The coverage bitmap and metrics of a single rasterized glyph
+ */
+struct GlyphBitmap {
+    // One byte of coverage per pixel, rows are tightly packed
+    std::vector<std::uint8_t> pixels;
+    unsigned width = 0;
+    unsigned height = 0;
+
+    // Position of the top left of the bitmap relative to the glyph origin,
+    // with y pointing down
+    float left = 0;
+    float top = 0;
+
+    float advance = 0;
+};
+
+/**
+ * @brief Rasterizes glyphs into CPU memory using FreeType. This does not
+ * need an OpenGL context
+ */
+class GlyphRasterizer final {
+  public:
+    GlyphRasterizer() = default;
+    ~GlyphRasterizer();
+
+    GlyphRasterizer(const GlyphRasterizer &) = delete;
+    GlyphRasterizer &operator=(const GlyphRasterizer &) = delete;
+
+    bool loadFromFile(const std::string &fontFile);
+
+    /**
+     * @brief Reads the font straight out of a mapped file, without copying
+     * it. The mapping is kept alive for as long as the font is open
+     */
+    bool loadFromMemory(std::shared_ptr<const MappedFile> fontData);
+    void close();
+    bool isOpen() const;
+
+    /**
+     * @brief Sets the size that glyphs and metrics are produced at
+     *
+     * @param size The size of the glyphs in pixels
+     */
+    void setPixelSize(unsigned size);
+
+    /**
+     * @brief Rasterizes a glyph at the current pixel size
+     *
+     * @param codepoint The unicode codepoint of the glyph
+     * @return GlyphBitmap The glyph, empty if the font has no such glyph
+     */
+    GlyphBitmap rasterize(std::uint32_t codepoint);
+
+    float getAdvance(std::uint32_t codepoint);
+    float getKerning(std::uint32_t before, std::uint32_t next) const;
+    float getLineHeight() const;
+
+  private:
+    FT_LibraryRec_ *m_library = nullptr;
+    FT_FaceRec_ *m_face = nullptr;
+    std::shared_ptr<const MappedFile> m_fontData;
+};
@@ -3,6 +3,7 @@
 #include <vector>
 
 #include "application.h"
+#include "gl/gl_errors.h"
 #include "gl/primitive.h"
 #include "gl/shader.h"
 #include "gl/vertex_array.h"
@@ -11,6 +12,7 @@
 
 #include <glad/glad.h>
 
+#include <cstring>
 #include <fstream>
 #include <sstream>
 #include <stdexcept>
@@ -27,14 +29,29 @@
                                        1.0f, 1.0f, 0.0f, 1.0f};
 */
 
-int main()
+int main(int argc, char **argv)
 {
+    // --gl-debug asks the driver to report OpenGL errors as they happen.
+    // Drivers often validate more in a debug context, so it is left off
+    // unless asked for, and release builds do not check for errors
+    bool isGlDebug = false;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--gl-debug") == 0) {
+            isGlDebug = true;
+        }
+    }
+
     sf::ContextSettings settings;
     settings.depthBits = 24;
     settings.stencilBits = 8;
     settings.antialiasingLevel = 4;
     settings.majorVersion = 3;
     settings.minorVersion = 3;
+    if (isGlDebug) {
+        // Drivers only have to report errors through KHR_debug to a debug
+        // context
+        settings.attributeFlags = sf::ContextSettings::Debug;
+    }
     sf::Window window({1600, 900}, "OpenGL", sf::Style::Default, settings);
     window.setFramerateLimit(60);
     window.setKeyRepeatEnabled(false);
@@ -43,6 +60,9 @@ int main()
         std::cout << "Unable to load OpenGL functions, exiting\n";
         return -1;
     }
+    if (isGlDebug) {
+        gl::setErrorPolicy(gl::ErrorPolicy::DebugOutput);
+    }
     Application app(window);
 
     app.run();
@@ -0,0 +1,133 @@
+#include "mapped_file.h"
+
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <utility>
+
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+MappedFile::MappedFile(MappedFile &&other)
+{
+    *this = std::move(other);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other)
+{
+    close();
+    m_data = other.m_data;
+    m_size = other.m_size;
+#ifdef _WIN32
+    m_buffer = std::move(other.m_buffer);
+#endif
+    other.reset();
+    return *this;
+}
+
+bool MappedFile::open(const std::string &path)
+{
+    close();
+#ifdef _WIN32
+    std::ifstream inFile(path, std::ios::binary | std::ios::ate);
+    if (!inFile.is_open()) {
+        return false;
+    }
+    m_buffer.resize(static_cast<std::size_t>(inFile.tellg()));
+    inFile.seekg(0);
+    inFile.read(reinterpret_cast<char *>(m_buffer.data()), m_buffer.size());
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+    return true;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+
+    // The mapping keeps the file alive, so the descriptor is not needed
+    void *data = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    m_data = static_cast<const std::uint8_t *>(data);
+    m_size = static_cast<std::size_t>(info.st_size);
+    return true;
+#endif
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+    m_buffer.clear();
+#else
+    if (m_data) {
+        munmap(const_cast<std::uint8_t *>(m_data), m_size);
+    }
+#endif
+    reset();
+}
+
+const std::uint8_t *MappedFile::getData() const
+{
+    return m_data;
+}
+
+std::size_t MappedFile::getSize() const
+{
+    return m_size;
+}
+
+void MappedFile::reset()
+{
+    m_data = nullptr;
+    m_size = 0;
+}
+
+std::shared_ptr<const MappedFile> mapSharedFile(const std::string &path)
+{
+    static std::mutex mutex;
+    static std::map<std::string, std::weak_ptr<const MappedFile>> files;
+
+    std::string key = std::filesystem::path(path).lexically_normal().string();
+    std::lock_guard<std::mutex> lock(mutex);
+    if (auto file = files[key].lock()) {
+        return file;
+    }
+
+    auto file = std::make_shared<MappedFile>();
+    if (!file->open(path)) {
+        files.erase(key);
+        return nullptr;
+    }
+    files[key] = file;
+    return file;
+}
+
+std::uint64_t hashBytes(const void *data, std::size_t size, std::uint64_t seed)
+{
+    auto bytes = static_cast<const std::uint8_t *>(data);
+    std::uint64_t hash = seed;
+    for (std::size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief A read-only view of a whole file, memory mapped where the platform
+ * supports it
+ */
+class MappedFile final {
+  public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(MappedFile &&other);
+    MappedFile &operator=(MappedFile &&other);
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool open(const std::string &path);
+    void close();
+
+    const std::uint8_t *getData() const;
+    std::size_t getSize() const;
+
+  private:
+    void reset();
+
+    const std::uint8_t *m_data = nullptr;
+    std::size_t m_size = 0;
+
+#ifdef _WIN32
+    // No mmap, so the file is just read into memory instead
+    std::vector<std::uint8_t> m_buffer;
+#endif
+};
+
+/**
+ * @brief Maps a file once for the whole process. While something holds the
+ * returned mapping, asking for the same file again returns the same mapping,
+ * so its pages are only ever in memory once
+ *
+ * @param path The file to map
+ * @return std::shared_ptr<const MappedFile> The mapping, or nullptr if the
+ * file could not be opened
+ */
+std::shared_ptr<const MappedFile> mapSharedFile(const std::string &path);
+
+/**
+ * @brief 64-bit FNV-1a hash of a block of memory
+ *
+ * @param data The memory to hash
+ * @param size The number of bytes to hash
+ * @param seed Hash to continue from, for hashing several blocks together
+ * @return std::uint64_t The hash
+ */
+std::uint64_t hashBytes(const void *data, std::size_t size,
+                        std::uint64_t seed = 0xcbf29ce484222325);
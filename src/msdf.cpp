@@ -0,0 +1,456 @@
+#include "msdf.h"
+
+#include "mapped_file.h"
+#include "thread_pool.h"
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include FT_OUTLINE_H
+
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+#include <iostream>
+
+// Based on the technique from Viktor Chlumsky's msdfgen
+// https://github.com/Chlumsky/msdfgen
+// Curves are flattened into polylines, but each curve keeps a single colour so
+// that corners stay sharp
+
+namespace {
+constexpr float INF = 1e20f;
+
+// How many line segments curves are split into
+constexpr int CONIC_SEGMENTS = 8;
+constexpr int CUBIC_SEGMENTS = 12;
+
+// sin(3 radians), the edges either side of sharper angles than this are
+// treated as a corner
+constexpr float CORNER_THRESHOLD = 0.1411f;
+
+enum Colour : unsigned {
+    RED = 1,
+    GREEN = 2,
+    BLUE = 4,
+    YELLOW = RED | GREEN,
+    MAGENTA = RED | BLUE,
+    CYAN = GREEN | BLUE,
+    WHITE = RED | GREEN | BLUE,
+};
+
+struct Edge {
+    std::vector<glm::vec2> points;
+    unsigned colour = WHITE;
+};
+
+using Contour = std::vector<Edge>;
+
+struct GlyphShape {
+    std::vector<Contour> contours;
+
+    // FreeType outlines can be wound either way, +1 if the inside of the
+    // glyph is to the left of its edges
+    float insideSign = 1.0f;
+};
+
+/**
+ * @brief The signed distance from a point to the closest point on an edge
+ */
+struct EdgeDistance {
+    float distance = -INF;
+
+    // How far the closest point is from being perpendicular to the edge, used
+    // to pick between edges that are the same distance away
+    float orthogonality = 1.0f;
+
+    const Edge *edge = nullptr;
+    std::size_t segment = 0;
+    float t = 0;
+};
+
+float cross(const glm::vec2 &a, const glm::vec2 &b)
+{
+    return a.x * b.y - a.y * b.x;
+}
+
+bool isCloser(const EdgeDistance &a, const EdgeDistance &b)
+{
+    float da = std::abs(a.distance);
+    float db = std::abs(b.distance);
+    return da < db || (da == db && a.orthogonality < b.orthogonality);
+}
+
+//
+//  Outline loading
+//
+struct OutlineBuilder {
+    GlyphShape *shape = nullptr;
+    glm::vec2 current;
+};
+
+glm::vec2 toVec(const FT_Vector *vector)
+{
+    return {vector->x / 64.0f, vector->y / 64.0f};
+}
+
+void addEdge(OutlineBuilder &builder, Edge &&edge)
+{
+    // Drop repeated points, so that every segment has a direction
+    auto isSamePoint = [](const glm::vec2 &a, const glm::vec2 &b) {
+        return a.x == b.x && a.y == b.y;
+    };
+    edge.points.erase(
+        std::unique(edge.points.begin(), edge.points.end(), isSamePoint),
+        edge.points.end());
+    if (edge.points.size() >= 2) {
+        builder.shape->contours.back().push_back(std::move(edge));
+    }
+}
+
+int moveTo(const FT_Vector *to, void *user)
+{
+    auto &builder = *static_cast<OutlineBuilder *>(user);
+    builder.shape->contours.emplace_back();
+    builder.current = toVec(to);
+    return 0;
+}
+
+int lineTo(const FT_Vector *to, void *user)
+{
+    auto &builder = *static_cast<OutlineBuilder *>(user);
+    Edge edge;
+    edge.points = {builder.current, toVec(to)};
+    builder.current = toVec(to);
+    addEdge(builder, std::move(edge));
+    return 0;
+}
+
+int conicTo(const FT_Vector *control, const FT_Vector *to, void *user)
+{
+    auto &builder = *static_cast<OutlineBuilder *>(user);
+    glm::vec2 p0 = builder.current;
+    glm::vec2 p1 = toVec(control);
+    glm::vec2 p2 = toVec(to);
+
+    Edge edge;
+    for (int i = 0; i <= CONIC_SEGMENTS; i++) {
+        float t = static_cast<float>(i) / CONIC_SEGMENTS;
+        float u = 1.0f - t;
+        edge.points.push_back(p0 * (u * u) + p1 * (2 * u * t) + p2 * (t * t));
+    }
+    builder.current = p2;
+    addEdge(builder, std::move(edge));
+    return 0;
+}
+
+int cubicTo(const FT_Vector *control1, const FT_Vector *control2,
+            const FT_Vector *to, void *user)
+{
+    auto &builder = *static_cast<OutlineBuilder *>(user);
+    glm::vec2 p0 = builder.current;
+    glm::vec2 p1 = toVec(control1);
+    glm::vec2 p2 = toVec(control2);
+    glm::vec2 p3 = toVec(to);
+
+    Edge edge;
+    for (int i = 0; i <= CUBIC_SEGMENTS; i++) {
+        float t = static_cast<float>(i) / CUBIC_SEGMENTS;
+        float u = 1.0f - t;
+        edge.points.push_back(p0 * (u * u * u) + p1 * (3 * u * u * t) +
+                              p2 * (3 * u * t * t) + p3 * (t * t * t));
+    }
+    builder.current = p3;
+    addEdge(builder, std::move(edge));
+    return 0;
+}
+
+GlyphShape loadGlyphShape(FT_Face face, char32_t codepoint)
+{
+    GlyphShape shape;
+    if (FT_Load_Char(face, codepoint,
+                     FT_LOAD_NO_HINTING | FT_LOAD_NO_BITMAP) != 0 ||
+        face->glyph->format != FT_GLYPH_FORMAT_OUTLINE) {
+        return shape;
+    }
+
+    FT_Outline_Funcs funcs;
+    funcs.move_to = moveTo;
+    funcs.line_to = lineTo;
+    funcs.conic_to = conicTo;
+    funcs.cubic_to = cubicTo;
+    funcs.shift = 0;
+    funcs.delta = 0;
+
+    OutlineBuilder builder;
+    builder.shape = &shape;
+    FT_Outline_Decompose(&face->glyph->outline, &funcs, &builder);
+
+    shape.contours.erase(
+        std::remove_if(shape.contours.begin(), shape.contours.end(),
+                       [](const Contour &contour) { return contour.empty(); }),
+        shape.contours.end());
+
+    if (FT_Outline_Get_Orientation(&face->glyph->outline) ==
+        FT_ORIENTATION_TRUETYPE) {
+        shape.insideSign = -1.0f;
+    }
+    return shape;
+}
+
+//
+//  Edge colouring
+//
+glm::vec2 startDirection(const Edge &edge)
+{
+    return glm::normalize(edge.points[1] - edge.points[0]);
+}
+
+glm::vec2 endDirection(const Edge &edge)
+{
+    auto count = edge.points.size();
+    return glm::normalize(edge.points[count - 1] - edge.points[count - 2]);
+}
+
+bool isCorner(const glm::vec2 &before, const glm::vec2 &after)
+{
+    return glm::dot(before, after) <= 0 ||
+           std::abs(cross(before, after)) > CORNER_THRESHOLD;
+}
+
+unsigned switchColour(unsigned colour, unsigned banned)
+{
+    const unsigned colours[] = {CYAN, MAGENTA, YELLOW};
+    for (unsigned i = 0; i < 3; i++) {
+        if (colours[i] == colour) {
+            for (unsigned j = 1; j < 3; j++) {
+                unsigned next = colours[(i + j) % 3];
+                if (next != banned) {
+                    return next;
+                }
+            }
+        }
+    }
+    return colours[0] == banned ? colours[1] : colours[0];
+}
+
+/**
+ * @brief Gives each edge a colour, such that the edges either side of a
+ * corner never share more than one channel
+ */
+void colourEdges(Contour &contour)
+{
+    std::size_t count = contour.size();
+    std::vector<std::size_t> corners;
+    for (std::size_t i = 0; i < count; i++) {
+        const Edge &previous = contour[(i + count - 1) % count];
+        if (isCorner(endDirection(previous), startDirection(contour[i]))) {
+            corners.push_back(i);
+        }
+    }
+
+    if (corners.empty()) {
+        // Smooth contour, every channel is the same
+        for (auto &edge : contour) {
+            edge.colour = WHITE;
+        }
+    }
+    else if (corners.size() == 1) {
+        // "Teardrop", split the edges into three colours from the one corner
+        const unsigned colours[] = {MAGENTA, WHITE, YELLOW};
+        for (std::size_t i = 0; i < count; i++) {
+            contour[(corners[0] + i) % count].colour = colours[3 * i / count];
+        }
+    }
+    else {
+        // Switch colour at every corner, making sure the last run of edges
+        // does not match the first as they also meet at a corner
+        std::size_t spline = 0;
+        unsigned colour = switchColour(WHITE, 0);
+        unsigned initialColour = colour;
+        for (std::size_t i = 0; i < count; i++) {
+            std::size_t index = (corners[0] + i) % count;
+            if (spline + 1 < corners.size() && corners[spline + 1] == index) {
+                spline++;
+                bool isLast = spline == corners.size() - 1;
+                colour = switchColour(colour, isLast ? initialColour : 0);
+            }
+            contour[index].colour = colour;
+        }
+    }
+}
+
+//
+//  Distance field generation
+//
+EdgeDistance edgeDistance(const Edge &edge, const glm::vec2 &point)
+{
+    EdgeDistance closest;
+    closest.edge = &edge;
+    for (std::size_t i = 0; i + 1 < edge.points.size(); i++) {
+        glm::vec2 a = edge.points[i];
+        glm::vec2 ab = edge.points[i + 1] - a;
+        glm::vec2 ap = point - a;
+
+        float t = glm::dot(ap, ab) / glm::dot(ab, ab);
+        glm::vec2 toPoint = point - (a + ab * std::min(std::max(t, 0.0f), 1.0f));
+
+        EdgeDistance distance;
+        distance.edge = &edge;
+        distance.segment = i;
+        distance.t = t;
+        distance.distance = glm::length(toPoint);
+        if (cross(ab, ap) < 0) {
+            distance.distance = -distance.distance;
+        }
+        distance.orthogonality = 0;
+        if ((t <= 0 || t >= 1) && glm::length(toPoint) > 0) {
+            distance.orthogonality = std::abs(
+                glm::dot(glm::normalize(ab), glm::normalize(toPoint)));
+        }
+
+        if (isCloser(distance, closest)) {
+            closest = distance;
+        }
+    }
+    return closest;
+}
+
+/**
+ * @brief Extends the edge past its end points as straight lines, this keeps
+ * the distance fields either side of a corner from rounding it off
+ */
+float pseudoDistance(const EdgeDistance &closest, const glm::vec2 &point)
+{
+    const auto &points = closest.edge->points;
+    float distance = closest.distance;
+    if (closest.segment == 0 && closest.t < 0) {
+        glm::vec2 direction = glm::normalize(points[1] - points[0]);
+        glm::vec2 toPoint = point - points[0];
+        if (glm::dot(toPoint, direction) < 0) {
+            float pseudo = cross(direction, toPoint);
+            if (std::abs(pseudo) <= std::abs(distance)) {
+                distance = pseudo;
+            }
+        }
+    }
+    else if (closest.segment + 2 == points.size() && closest.t > 1) {
+        auto last = points.size() - 1;
+        glm::vec2 direction = glm::normalize(points[last] - points[last - 1]);
+        glm::vec2 toPoint = point - points[last];
+        if (glm::dot(toPoint, direction) > 0) {
+            float pseudo = cross(direction, toPoint);
+            if (std::abs(pseudo) <= std::abs(distance)) {
+                distance = pseudo;
+            }
+        }
+    }
+    return distance;
+}
+
+MultiDistanceField generateField(GlyphShape &shape, unsigned spread)
+{
+    float minX = INF;
+    float minY = INF;
+    float maxX = -INF;
+    float maxY = -INF;
+    for (auto &contour : shape.contours) {
+        colourEdges(contour);
+        for (auto &edge : contour) {
+            for (auto &point : edge.points) {
+                minX = std::min(minX, point.x);
+                minY = std::min(minY, point.y);
+                maxX = std::max(maxX, point.x);
+                maxY = std::max(maxY, point.y);
+            }
+        }
+    }
+    if (shape.contours.empty()) {
+        minX = minY = maxX = maxY = 0;
+    }
+
+    MultiDistanceField field;
+    float left = std::floor(minX) - spread;
+    float top = std::ceil(maxY) + spread;
+    field.width = static_cast<unsigned>(std::ceil(maxX) + spread - left);
+    field.height = static_cast<unsigned>(top - (std::floor(minY) - spread));
+    field.left = left;
+    field.top = -top;
+    field.pixels.assign(field.width * field.height * 3, 0);
+
+    float range = static_cast<float>(spread) * 2.0f;
+    for (unsigned y = 0; y < field.height; y++) {
+        for (unsigned x = 0; x < field.width; x++) {
+            glm::vec2 point{left + x + 0.5f, top - y - 0.5f};
+
+            EdgeDistance closest;
+            EdgeDistance channels[3];
+            for (const auto &contour : shape.contours) {
+                for (const auto &edge : contour) {
+                    EdgeDistance distance = edgeDistance(edge, point);
+                    if (isCloser(distance, closest)) {
+                        closest = distance;
+                    }
+                    for (unsigned c = 0; c < 3; c++) {
+                        if ((edge.colour & (1 << c)) &&
+                            isCloser(distance, channels[c])) {
+                            channels[c] = distance;
+                        }
+                    }
+                }
+            }
+
+            for (unsigned c = 0; c < 3; c++) {
+                float distance = -INF;
+                if (channels[c].edge) {
+                    distance = pseudoDistance(channels[c], point);
+                }
+                else if (closest.edge) {
+                    distance = closest.distance;
+                }
+                float value = 0.5f + distance * shape.insideSign / range;
+                value = std::min(std::max(value, 0.0f), 1.0f);
+                field.pixels[(y * field.width + x) * 3 + c] =
+                    static_cast<std::uint8_t>(value * 255.0f);
+            }
+        }
+    }
+    return field;
+}
+} // namespace
+
+std::vector<MultiDistanceField>
+createMultiDistanceFields(const MappedFile &fontData,
+                          const std::u32string &codepoints, unsigned size,
+                          unsigned spread, ThreadPool &pool)
+{
+    FT_Library library;
+    if (FT_Init_FreeType(&library) != 0) {
+        std::cerr << "Could not initialise FreeType\n";
+        return {};
+    }
+    FT_Face face;
+    if (FT_New_Memory_Face(library, fontData.getData(),
+                           static_cast<FT_Long>(fontData.getSize()), 0,
+                           &face) != 0) {
+        std::cerr << "Could not load font outlines\n";
+        FT_Done_FreeType(library);
+        return {};
+    }
+    FT_Set_Pixel_Sizes(face, 0, size);
+
+    // FreeType faces cannot be shared between threads, so the outlines are
+    // read up front and only the distance fields are made on the workers
+    std::vector<GlyphShape> shapes;
+    for (auto codepoint : codepoints) {
+        shapes.push_back(loadGlyphShape(face, codepoint));
+    }
+    FT_Done_Face(face);
+    FT_Done_FreeType(library);
+
+    std::vector<MultiDistanceField> fields(shapes.size());
+    for (std::size_t i = 0; i < shapes.size(); i++) {
+        pool.addTask([&, i] { fields[i] = generateField(shapes[i], spread); });
+    }
+    pool.wait();
+    return fields;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class MappedFile;
+class ThreadPool;
+
+/**
+ * @brief A three channel (RGB) distance field of a glyph. The median of the
+ * channels is the distance, 0.5 (127) being the edge of the glyph
+ */
+struct MultiDistanceField {
+    std::vector<std::uint8_t> pixels;
+    unsigned width = 0;
+    unsigned height = 0;
+
+    // Position of the top left of the field relative to the glyph origin, with
+    // y pointing down
+    float left = 0;
+    float top = 0;
+};
+
+/**
+ * @brief Creates a multi-channel signed distance field for each codepoint, by
+ * reading the glyph outlines from a font file
+ *
+ * @param fontData The font file to read the outlines from
+ * @param codepoints The unicode codepoints to create distance fields for
+ * @param size The size of the glyphs in pixels
+ * @param spread How far from the edge the distance field reaches, in pixels.
+ * Every field is padded by this much on every side
+ * @param pool The workers to spread the glyphs across
+ * @return std::vector<MultiDistanceField> One field per codepoint, in the same
+ * order, or empty if the font could not be loaded
+ */
+std::vector<MultiDistanceField>
+createMultiDistanceFields(const MappedFile &fontData,
+                          const std::u32string &codepoints, unsigned size,
+                          unsigned spread, ThreadPool &pool);
@@ -0,0 +1,115 @@
+#include "sdf.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+constexpr float INF = 1e20f;
+
+// Felzenszwalb & Huttenlocher, "Distance Transforms of Sampled Functions"
+// Squared distance transform of one row or column, in place
+void distanceTransform(float *grid, unsigned offset, unsigned stride,
+                       unsigned length, std::vector<float> &f,
+                       std::vector<float> &z, std::vector<unsigned> &v)
+{
+    for (unsigned q = 0; q < length; q++) {
+        f[q] = grid[offset + q * stride];
+    }
+
+    unsigned k = 0;
+    v[0] = 0;
+    z[0] = -INF;
+    z[1] = INF;
+    for (unsigned q = 1; q < length; q++) {
+        auto intersect = [&](unsigned r) {
+            return ((f[q] + q * q) - (f[r] + r * r)) / (2.0f * q - 2.0f * r);
+        };
+        float s = intersect(v[k]);
+        while (s <= z[k]) {
+            k--;
+            s = intersect(v[k]);
+        }
+        k++;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = INF;
+    }
+
+    k = 0;
+    for (unsigned q = 0; q < length; q++) {
+        while (z[k + 1] < q) {
+            k++;
+        }
+        float dx = static_cast<float>(q) - static_cast<float>(v[k]);
+        grid[offset + q * stride] = dx * dx + f[v[k]];
+    }
+}
+
+/**
+ * @brief Finds the squared distance from every pixel to the closest pixel
+ * that is "on" in the grid. Pixels that are on must be 0, other pixels INF
+ */
+void distanceTransform(std::vector<float> &grid, unsigned width,
+                       unsigned height)
+{
+    unsigned length = std::max(width, height);
+    std::vector<float> f(length);
+    std::vector<float> z(length + 1);
+    std::vector<unsigned> v(length);
+
+    for (unsigned x = 0; x < width; x++) {
+        distanceTransform(grid.data(), x, width, height, f, z, v);
+    }
+    for (unsigned y = 0; y < height; y++) {
+        distanceTransform(grid.data(), y * width, 1, width, f, z, v);
+    }
+}
+} // namespace
+
+DistanceField createDistanceField(const std::vector<std::uint8_t> &coverage,
+                                  unsigned width, unsigned height,
+                                  unsigned downscale, unsigned spread)
+{
+    DistanceField field;
+    field.width = (width + downscale - 1) / downscale + spread * 2;
+    field.height = (height + downscale - 1) / downscale + spread * 2;
+
+    // Work at the full resolution of the coverage bitmap, with the shape
+    // offset by the output padding
+    unsigned sourceWidth = field.width * downscale;
+    unsigned sourceHeight = field.height * downscale;
+    unsigned padding = spread * downscale;
+
+    std::vector<float> outside(sourceWidth * sourceHeight, INF);
+    std::vector<float> inside(sourceWidth * sourceHeight, 0.0f);
+    for (unsigned y = 0; y < height; y++) {
+        for (unsigned x = 0; x < width; x++) {
+            if (coverage[y * width + x] >= 128) {
+                unsigned index = (y + padding) * sourceWidth + x + padding;
+                outside[index] = 0.0f;
+                inside[index] = INF;
+            }
+        }
+    }
+    distanceTransform(outside, sourceWidth, sourceHeight);
+    distanceTransform(inside, sourceWidth, sourceHeight);
+
+    // Sample the centre of each block of source pixels
+    float maxDistance = static_cast<float>(spread * downscale);
+    field.pixels.resize(field.width * field.height);
+    for (unsigned y = 0; y < field.height; y++) {
+        for (unsigned x = 0; x < field.width; x++) {
+            unsigned sx = x * downscale + downscale / 2;
+            unsigned sy = y * downscale + downscale / 2;
+            unsigned index = sy * sourceWidth + sx;
+
+            float distance =
+                std::sqrt(outside[index]) - std::sqrt(inside[index]);
+            float value = 0.5f - distance / (maxDistance * 2.0f);
+            value = std::min(std::max(value, 0.0f), 1.0f);
+            field.pixels[y * field.width + x] =
+                static_cast<std::uint8_t>(value * 255.0f);
+        }
+    }
+    return field;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief A single channel distance field image, 0.5 (127) being the edge of
+ * the shape, with larger values being inside of it
+ */
+struct DistanceField {
+    std::vector<std::uint8_t> pixels;
+    unsigned width = 0;
+    unsigned height = 0;
+};
+
+/**
+ * @brief Creates a downscaled signed distance field from a coverage bitmap
+ *
+ * @param coverage The coverage of the shape, one byte per pixel
+ * @param width The width of the coverage bitmap
+ * @param height The height of the coverage bitmap
+ * @param downscale How many times smaller the distance field is than the
+ * coverage bitmap
+ * @param spread How far from the edge the distance field reaches, in pixels
+ * of the output. The output is padded by this much on every side
+ * @return DistanceField The distance field of the shape
+ */
+DistanceField createDistanceField(const std::vector<std::uint8_t> &coverage,
+                                  unsigned width, unsigned height,
+                                  unsigned downscale, unsigned spread);
@@ -1,30 +1,118 @@
 #include "text.h"
 
+#include "baked_atlas.h"
+#include "gl/draw_list.h"
+#include "gl/primitive.h"
 #include "gl/shader.h"
+#include "gl/stream_buffer.h"
 #include "maths.h"
+#include "msdf.h"
+#include "sdf.h"
+#include "thread_pool.h"
+#include "utf8.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <sstream>
 
 namespace {
-struct Mesh {
-    std::vector<GLfloat> vertices;
-    std::vector<GLfloat> textureCoords;
-    std::vector<GLuint> indices;
-    GLuint icount = 0;
+constexpr std::uint8_t NO_CHAR_INDEX = 0xFF;
+
+// Distance field glyphs are rasterized this many times larger than the
+// bitmap scale, and then reduced to a distance field of the bitmap scale
+constexpr unsigned SDF_UPSCALE = 4;
+
+// How many pixels either side of a glyph edge the distance fields reach
+constexpr unsigned SDF_SPREAD = 4;
+
+// Page 0 holds the char set and is never evicted, so it may grow as large as
+// the char set needs. Other pages are capped, and are evicted as a whole
+constexpr unsigned CHAR_SET_PAGE_MAX_SIZE = 8192;
+constexpr unsigned PAGE_MAX_SIZE = 1024;
+
+// Keeps the advance of a glyph that has no room in the atlas, so the text
+// around it is still spaced out right
+sf::Glyph withoutImage(sf::Glyph glyph)
+{
+    glyph.bounds = {};
+    glyph.textureRect = {};
+    return glyph;
+}
+
+// Smaller sizes a font is rasterized at for small text, built the first time
+// text is drawn at that size
+constexpr std::array<unsigned, 4> SIZE_BUCKETS = {16, 32, 64, 128};
+
+const std::string BAKED_ATLAS_DIRECTORY = "cache/";
+
+// Text vertex positions are whole numbers of this fraction of a pixel at the
+// bitmap scale. Text too large for that to fit in 16 bits uses fewer
+constexpr float POSITION_SUBPIXELS = 4;
+constexpr float MAX_PACKED_POSITION = 32767.0f;
+
+// Layout versions are unique across every font, so a text notices when its
+// font has been replaced, even by one at the same address. Atlases are
+// filled on worker threads, hence the atomic
+std::atomic<unsigned> layoutVersions{0};
+
+unsigned nextLayoutVersion()
+{
+    return ++layoutVersions;
+}
+
+const std::vector<gl::VertexAttribute> TEXT_VERTEX_LAYOUT = {
+    {2, GL_SHORT},
+    {2, GL_UNSIGNED_SHORT, true},
 };
 
+std::int16_t packPosition(float position, float subpixels)
+{
+    float packed = std::round(position * subpixels);
+    assert(std::abs(packed) <= MAX_PACKED_POSITION + 1.0f);
+    return static_cast<std::int16_t>(
+        std::clamp(packed, -MAX_PACKED_POSITION, MAX_PACKED_POSITION));
+}
+
+std::uint16_t packTextureCoord(float coord)
+{
+    return static_cast<std::uint16_t>(std::round(std::clamp(coord, 0.0f, 1.0f) * 65535.0f));
+}
+
+/**
+ * @brief Finds how many elements at the start of two buffers are the same,
+ * which is how much of a buffer does not need sending again
+ */
+template <typename T>
+std::size_t commonPrefix(const std::vector<T>& a, const std::vector<T>& b)
+{
+    std::size_t count = std::min(a.size(), b.size());
+    std::size_t i = 0;
+    while (i < count && std::memcmp(&a[i], &b[i], sizeof(T)) == 0) {
+        i++;
+    }
+    return i;
+}
+
 //Adapted from https://github.com/SFML/SFML/blob/master/src/SFML/Graphics/Text.cpp
 // void addGlyphQuad and ensureGeometryUpdate
 
 /**
- * @brief Creates a quad that contains a character, and adds to a mesh
+ * @brief Creates a quad that contains a character. The indices come from the
+ * shared quad index buffer
  * 
- * @param mesh The mesh to add the character to
+ * @param vertices Where to write the 4 vertices of the quad
  * @param glyph The glyph being added
  * @param c The character being added
  * @param imageSize The size of the texture atlas
  * @param position The world position to put this char at
  * @param maxHeight The maximum height of the chars
  */
-void addCharacter(Mesh &mesh, const sf::Glyph &glyph, float size, const sf::Vector2f& position)
+void addCharacter(TextVertex* vertices, const sf::Glyph &glyph, float size,
+                  const sf::Vector2f& position, float subpixels)
 {
     //Find the vertex positions of the the quad that will render this character
     float left = glyph.bounds.left;
@@ -33,81 +121,757 @@ void addCharacter(Mesh &mesh, const sf::Glyph &glyph, float size, const sf::Vect
     float bottom = glyph.bounds.top + glyph.bounds.height;
 
     // Find the texture coords in the texture
+    sf::FloatRect texRect = getGlyphTextureRect(glyph, size);
+    float texLeft = texRect.left;
+    float texRight = texRect.left + texRect.width;
+    float texTop = texRect.top;
+    float texBottom  = texRect.top + texRect.height;
+
+    // Write the vertices of the quad
+    auto vertex = [&](float x, float y, float u, float v) {
+        return TextVertex{packPosition(position.x + x, subpixels),
+                          packPosition(position.y + y, subpixels),
+                          packTextureCoord(u), packTextureCoord(v)};
+    };
+    vertices[0] = vertex(left, top, texLeft, texTop);
+    vertices[1] = vertex(right, top, texRight, texTop);
+    vertices[2] = vertex(right, bottom, texRight, texBottom);
+    vertices[3] = vertex(left, bottom, texLeft, texBottom);
+}
+
+/**
+ * @brief Writes the two glyph table texels of a glyph: its bounds, and its
+ * rect in the atlas with the same padding as addCharacter
+ */
+void writeGlyphRow(std::vector<GLfloat>& table, unsigned id,
+                   const sf::Glyph& glyph)
+{
     float pad = 1.0f;
-    float texLeft = (static_cast<float>(glyph.textureRect.left) - pad) / size;
-    float texRight = (static_cast<float>(glyph.textureRect.left + glyph.textureRect.width) + pad) / size;
-    float texTop = (static_cast<float>(glyph.textureRect.top) - pad) / size;
-    float texBottom  = (static_cast<float>(glyph.textureRect.top + glyph.textureRect.height) + pad) / size;
-
-    // Add the vertex positions to the mesh
-    float scale = 1;
-    mesh.vertices.insert(mesh.vertices.end(), {
-         (position.x + left) / scale,  (position.y + top) / scale,
-        (position.x + right) / scale, (position.y + top) / scale,
-        (position.x + right) / scale, (position.y + bottom) / scale,
-        (position.x + left) / scale, (position.y + bottom) / scale,
-
-    });
-
-    // Add the textrue coords to the mesh
-    mesh.textureCoords.insert(mesh.textureCoords.end(), {
-        texLeft, texTop,
-        texRight, texTop,
-        texRight, texBottom,
-        texLeft, texBottom,
-    });
-
-    // Add indices to the mesh
-    mesh.indices.push_back(mesh.icount);
-    mesh.indices.push_back(mesh.icount + 1);
-    mesh.indices.push_back(mesh.icount + 2);
-    mesh.indices.push_back(mesh.icount + 2);
-    mesh.indices.push_back(mesh.icount + 3);
-    mesh.indices.push_back(mesh.icount);
-    mesh.icount += 4;
+    auto& bounds = glyph.bounds;
+    auto& rect = glyph.textureRect;
+    std::size_t first = static_cast<std::size_t>(id) * 8;
+    GLfloat row[8] = {
+        bounds.left, bounds.top, bounds.width, bounds.height,
+        rect.left - pad, rect.top - pad, rect.width + pad * 2, rect.height + pad * 2,
+    };
+    std::copy(std::begin(row), std::end(row), table.begin() + first);
 }
 
 } // namespace 
 
+const std::vector<gl::VertexAttribute>& getTextVertexLayout()
+{
+    return TEXT_VERTEX_LAYOUT;
+}
+
+sf::FloatRect getGlyphTextureRect(const sf::Glyph& glyph, float atlasSize)
+{
+    // The padding around each glyph in the atlas is sampled too, so edges
+    // fade out rather than being cut off
+    float pad = 1.0f;
+    auto& rect = glyph.textureRect;
+    return {(rect.left - pad) / atlasSize, (rect.top - pad) / atlasSize,
+            (rect.width + pad * 2) / atlasSize,
+            (rect.height + pad * 2) / atlasSize};
+}
+
+Font::Font() = default;
+
+Font::~Font() = default;
+
+void Font::init(const std::string& fontFile, unsigned bitmapScale,
+                FontType type)
+{
+    if (m_loading.valid()) {
+        m_loading.get();
+    }
+    m_fontFile = fontFile;
+    m_bitmapScale = bitmapScale;
+    m_type = type;
+    m_isLoaded = false;
+    m_sizeBuckets.clear();
+    load();
+    finishLoading();
+}
 
-void Font::init(const std::string& fontFile, unsigned bitmapScale)
+void Font::initAsync(const std::string& fontFile, unsigned bitmapScale,
+                     FontType type)
 {
+    if (m_loading.valid()) {
+        m_loading.get();
+    }
+    m_fontFile = fontFile;
     m_bitmapScale = bitmapScale;
-    m_font.loadFromFile(fontFile);
+    m_type = type;
+    m_isLoaded = false;
+
+    // The old pages own textures, which have to be freed on the GL thread
+    m_pages.clear();
+    m_sizeBuckets.clear();
+    m_loading = std::async(std::launch::async, [this] { load(); });
+}
+
+bool Font::isLoaded() const
+{
+    return m_isLoaded;
+}
+
+void Font::waitUntilLoaded()
+{
+    if (!m_isLoaded && m_loading.valid()) {
+        m_loading.get();
+        finishLoading();
+    }
+}
+
+void Font::load()
+{
+    assert(m_charSet.size() < NO_CHAR_INDEX);
+    m_charIndices.fill(NO_CHAR_INDEX);
+    for (std::size_t i = 0; i < m_charSet.size(); i++) {
+        m_charIndices[static_cast<unsigned char>(m_charSet[i])] = i;
+    }
+    m_glyphs.fill({});
+    m_extraGlyphs.clear();
+    m_unplaceableGlyphs.clear();
+    m_freeGlyphIds.clear();
+    m_glyphIdCount = m_charSet.size() + 1;
+    m_glyphTableChanged = true;
+    m_rasterizer.close();
+    if (m_type == FontType::MultiChannelSignedDistanceField && !m_fieldPool) {
+        m_fieldPool = std::make_unique<ThreadPool>();
+    }
+
+    // The atlas and metrics are baked to disk the first time a font is
+    // loaded, so that later runs never have to touch FreeType
+    BakedAtlasKey key;
+    key.charSetHash = hashBytes(m_charSet.data(), m_charSet.size());
+    key.bitmapScale = m_bitmapScale;
+    key.fontType = static_cast<std::uint32_t>(m_type);
+
+    // The file is mapped once for every Font that uses it, and FreeType reads
+    // straight out of the mapping
+    m_fontData = mapSharedFile(m_fontFile);
+    if (m_fontData) {
+        key.fontHash = hashBytes(m_fontData->getData(), m_fontData->getSize());
+    }
+    else {
+        std::cerr << "Could not load: " << m_fontFile << '\n';
+    }
+
+    std::ostringstream cacheFile;
+    cacheFile << BAKED_ATLAS_DIRECTORY << std::hex << key.fontHash << '_'
+              << std::dec << key.bitmapScale << '_' << key.fontType
+              << ".atlas";
+    if (readBakedAtlas(cacheFile.str(), key)) {
+        return;
+    }
+
+    m_rasterizer.loadFromMemory(m_fontData);
+    createAtlas();
+    addGlyphs(std::u32string(m_charSet.begin(), m_charSet.end()));
+    m_lineHeight = m_rasterizer.getLineHeight();
+    createKerningTable();
+
+    if (key.fontHash != 0) {
+        writeBakedAtlas(cacheFile.str(), key);
+    }
+}
+
+void Font::finishLoading()
+{
+    for (auto& page : m_pages) {
+        page.atlas.upload();
+    }
+    uploadGlyphTable();
+    m_isLoaded = true;
+    m_layoutVersion = nextLayoutVersion();
+}
+
+void Font::update()
+{
+    if (!m_isLoaded) {
+        // Loading on another thread, so nothing else can be touched until it
+        // has finished
+        if (!m_loading.valid() ||
+            m_loading.wait_for(std::chrono::seconds(0)) !=
+                std::future_status::ready) {
+            return;
+        }
+        m_loading.get();
+        finishLoading();
+    }
+    m_frame++;
+    for (auto& page : m_pages) {
+        page.atlas.resetUploadedBytes();
+        page.atlas.upload();
+    }
+    uploadGlyphTable();
+    for (auto& bucket : m_sizeBuckets) {
+        bucket.second->update();
+    }
+}
+
+Font& Font::getSizeBucket(float charSize)
+{
+    // Distance fields already scale down cleanly, and a smaller one would
+    // only have a smaller distance range to work with
+    if (m_type != FontType::Bitmap) {
+        return *this;
+    }
+
+    // The smallest size that is still at least as big as the text, so glyphs
+    // are only ever scaled down
+    unsigned size = m_bitmapScale;
+    for (auto bucket : SIZE_BUCKETS) {
+        if (bucket < m_bitmapScale && bucket >= charSize) {
+            size = bucket;
+            break;
+        }
+    }
+    if (size == m_bitmapScale) {
+        return *this;
+    }
+
+    auto& font = m_sizeBuckets[size];
+    if (!font) {
+        font = std::make_unique<Font>();
+        font->setAtlasBudget(m_atlasBudget);
+        font->initAsync(m_fontFile, size, m_type);
+    }
+    return *font;
+}
+
+void Font::loadGlyphs(const std::u32string& codepoints)
+{
+    if (!m_isLoaded) {
+        return;
+    }
+
+    // Control characters are never drawn, so are not worth a slot
+    std::u32string unique;
+    for (auto codepoint : codepoints) {
+        if (codepoint >= U' ') {
+            unique.push_back(codepoint);
+        }
+    }
+    std::sort(unique.begin(), unique.end());
+    unique.erase(std::unique(unique.begin(), unique.end()), unique.end());
+
+    // Pages of glyphs that are already resident are marked as used first, so
+    // loading the rest can never evict them
+    std::u32string missing;
+    for (auto codepoint : unique) {
+        if (hasGlyph(codepoint)) {
+            touchPage(getGlyphPage(codepoint));
+            m_glyphHits++;
+        }
+        else {
+            missing.push_back(codepoint);
+            m_glyphMisses++;
+        }
+    }
+    if (missing.empty()) {
+        return;
+    }
+
+    // Fonts loaded from the cache only open FreeType once a glyph outside of
+    // the char set is needed
+    if (!m_rasterizer.isOpen() && !m_rasterizer.loadFromMemory(m_fontData)) {
+        return;
+    }
+    addGlyphs(missing);
+    for (auto& page : m_pages) {
+        page.atlas.upload();
+    }
+    uploadGlyphTable();
+}
+
+void Font::addGlyphs(const std::u32string& codepoints)
+{
+    switch (m_type) {
+        case FontType::Bitmap:
+            addBitmapGlyphs(codepoints);
+            break;
+
+        case FontType::SignedDistanceField:
+            addDistanceFieldGlyphs(codepoints);
+            break;
+
+        case FontType::MultiChannelSignedDistanceField:
+            addMultiDistanceFieldGlyphs(codepoints);
+            break;
+    }
+
+    // Metrics, such as kerning, are always read at the bitmap scale
+    m_rasterizer.setPixelSize(m_bitmapScale);
+}
+
+bool Font::isInCharSet(char32_t codepoint) const
+{
+    return codepoint < m_charIndices.size() &&
+           m_charIndices[codepoint] != NO_CHAR_INDEX;
+}
+
+bool Font::hasGlyph(char32_t codepoint) const
+{
+    return isInCharSet(codepoint) ||
+           m_extraGlyphs.find(codepoint) != m_extraGlyphs.end() ||
+           m_unplaceableGlyphs.find(codepoint) != m_unplaceableGlyphs.end();
+}
+
+void Font::storeGlyph(char32_t codepoint, sf::Glyph glyph,
+                      const std::uint8_t* pixels, unsigned width,
+                      unsigned height)
+{
+    if (isInCharSet(codepoint)) {
+        if (!addToPage(0, pixels, width, height, glyph.textureRect)) {
+            std::cerr << "No room in the atlas of " << m_fontFile
+                      << " for char " << static_cast<std::uint32_t>(codepoint)
+                      << '\n';
+            glyph = withoutImage(glyph);
+        }
+        m_glyphs[codepoint] = glyph;
+        return;
+    }
+
+    // Checked before any page is made or evicted for it, as no page would
+    // ever have room
+    if (!GlyphAtlas::canFit(width, height, PAGE_MAX_SIZE)) {
+        std::cerr << "Glyph " << static_cast<std::uint32_t>(codepoint)
+                  << " of " << m_fontFile << " is too large for the atlas\n";
+        m_unplaceableGlyphs[codepoint] = withoutImage(glyph);
+        return;
+    }
+
+    // Try the pages that already exist, then a new page while the budget
+    // allows it, and finally reuse the least recently used page. There is
+    // always room for one page, however small the budget
+    for (unsigned page = 1; page < m_pages.size(); page++) {
+        if (addToPage(page, pixels, width, height, glyph.textureRect)) {
+            addExtraGlyph(codepoint, glyph, page);
+            return;
+        }
+    }
+    unsigned page = 0;
+    if (m_pages.size() > 1 && getPageBytes() >= m_atlasBudget) {
+        page = findEvictablePage();
+    }
+    if (page == 0) {
+        // Every page is in use this frame, so the glyph goes over budget
+        // rather than being dropped and rasterized again on every layout
+        if (m_pages.size() > 1 && getPageBytes() >= m_atlasBudget &&
+            !m_hasWarnedAtlasBudget) {
+            std::cerr << "Atlas budget of " << m_fontFile
+                      << " exceeded, as every page is in use\n";
+            m_hasWarnedAtlasBudget = true;
+        }
+        createPage(PAGE_MAX_SIZE);
+        page = m_pages.size() - 1;
+    }
+    else {
+        evictPage(page);
+    }
+    if (addToPage(page, pixels, width, height, glyph.textureRect)) {
+        addExtraGlyph(codepoint, glyph, page);
+    }
+}
+
+void Font::addExtraGlyph(char32_t codepoint, const sf::Glyph& glyph,
+                         unsigned page)
+{
+    // Ids of evicted glyphs are reused, so the table only grows as large as
+    // the most glyphs resident at once
+    unsigned id = m_glyphIdCount;
+    if (!m_freeGlyphIds.empty()) {
+        id = m_freeGlyphIds.back();
+        m_freeGlyphIds.pop_back();
+    }
+    else {
+        m_glyphIdCount++;
+    }
+    m_extraGlyphs[codepoint] = {glyph, page, id};
+
+    // Written now, and sent with the other new rows on the next upload
+    std::size_t rowEnd = (static_cast<std::size_t>(id) + 1) * 8;
+    if (m_glyphTableData.size() < rowEnd) {
+        m_glyphTableData.resize(rowEnd);
+    }
+    writeGlyphRow(m_glyphTableData, id, glyph);
+    m_dirtyGlyphIds.push_back(id);
+}
+
+bool Font::addToPage(unsigned page, const std::uint8_t* pixels,
+                     unsigned width, unsigned height, sf::IntRect& rect)
+{
+    GlyphAtlas& atlas = m_pages[page].atlas;
+    unsigned size = atlas.getSize();
+    sf::Vector2u position;
+    if (!atlas.add(pixels, width, height, position)) {
+        return false;
+    }
+    // Texture coords are relative to the page size, so growing a page means
+    // the text using it has to be laid out again
+    if (atlas.getSize() != size) {
+        m_layoutVersion = nextLayoutVersion();
+    }
+    touchPage(page);
+    rect = {static_cast<int>(position.x), static_cast<int>(position.y),
+            static_cast<int>(width), static_cast<int>(height)};
+    return true;
+}
+
+void Font::createPage(unsigned maxSize)
+{
+    // Coverage and single distance fields only need one channel, which is
+    // sampled as white with the value in alpha
+    m_pages.emplace_back();
+    FontPage& page = m_pages.back();
+    page.atlas.create(getChannelCount(), maxSize);
+    if (m_type != FontType::Bitmap) {
+        page.atlas.setFilters(GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    }
+    page.lastUsed = m_frame;
+}
+
+void Font::createAtlas()
+{
+    m_pages.clear();
+    createPage(CHAR_SET_PAGE_MAX_SIZE);
+}
+
+std::size_t Font::getPageBytes() const
+{
+    // Pages start small and grow, so their actual sizes are counted
+    std::size_t bytes = 0;
+    for (auto& page : m_pages) {
+        bytes += static_cast<std::size_t>(page.atlas.getSize()) *
+                 page.atlas.getSize() * page.atlas.getChannels();
+    }
+    return bytes;
+}
+
+bool Font::isOverAtlasBudget() const
+{
+    return getPageBytes() > m_atlasBudget;
+}
+
+unsigned Font::findEvictablePage() const
+{
+    // Pages used this frame are still needed by something being drawn
+    unsigned oldest = 0;
+    for (unsigned page = 1; page < m_pages.size(); page++) {
+        if (m_pages[page].lastUsed < m_frame &&
+            (oldest == 0 || m_pages[page].lastUsed < m_pages[oldest].lastUsed)) {
+            oldest = page;
+        }
+    }
+    return oldest;
+}
+
+void Font::evictPage(unsigned page)
+{
+    for (auto itr = m_extraGlyphs.begin(); itr != m_extraGlyphs.end();) {
+        if (itr->second.page == page) {
+            m_freeGlyphIds.push_back(itr->second.id);
+            itr = m_extraGlyphs.erase(itr);
+            m_evictedGlyphs++;
+        }
+        else {
+            itr++;
+        }
+    }
+    m_pages[page].atlas.create(getChannelCount(), PAGE_MAX_SIZE);
+    m_layoutVersion = nextLayoutVersion();
+}
+
+void Font::touchPage(unsigned page)
+{
+    if (page < m_pages.size()) {
+        m_pages[page].lastUsed = m_frame;
+    }
+}
+
+bool Font::readBakedAtlas(const std::string& cacheFile,
+                          const BakedAtlasKey& key)
+{
+    BakedAtlasFile file;
+    if (!file.open(cacheFile, key) || file.getChannels() != getChannelCount() ||
+        file.getKerningCount() != m_charSet.size() * m_charSet.size()) {
+        return false;
+    }
+
+    std::vector<sf::IntRect> rects;
+    for (std::size_t i = 0; i < file.getGlyphCount(); i++) {
+        const BakedGlyph& baked = file.getGlyphs()[i];
+        if (baked.codepoint >= m_glyphs.size()) {
+            continue;
+        }
+        sf::Glyph& glyph = m_glyphs[baked.codepoint];
+        glyph.advance = baked.advance;
+        glyph.bounds = {baked.bounds[0], baked.bounds[1], baked.bounds[2],
+                        baked.bounds[3]};
+        glyph.textureRect = {baked.textureRect[0], baked.textureRect[1],
+                             baked.textureRect[2], baked.textureRect[3]};
+        rects.push_back(glyph.textureRect);
+    }
+    m_kerning.assign(file.getKerning(),
+                     file.getKerning() + file.getKerningCount());
+    m_lineHeight = file.getLineHeight();
+
+    // The packer is rebuilt around the baked glyphs, so more can still be
+    // added later
+    createAtlas();
+    m_pages[0].atlas.load(file.getImageSize(), file.getPixels(), rects);
+    return true;
+}
+
+void Font::writeBakedAtlas(const std::string& cacheFile,
+                           const BakedAtlasKey& key) const
+{
+    BakedAtlas atlas;
     for (auto character : m_charSet) {
-        m_font.getGlyph(character, bitmapScale, false);
+        const sf::Glyph& glyph =
+            getGlyph(static_cast<unsigned char>(character));
+        BakedGlyph baked;
+        baked.codepoint = static_cast<unsigned char>(character);
+        baked.advance = glyph.advance;
+        baked.bounds[0] = glyph.bounds.left;
+        baked.bounds[1] = glyph.bounds.top;
+        baked.bounds[2] = glyph.bounds.width;
+        baked.bounds[3] = glyph.bounds.height;
+        baked.textureRect[0] = glyph.textureRect.left;
+        baked.textureRect[1] = glyph.textureRect.top;
+        baked.textureRect[2] = glyph.textureRect.width;
+        baked.textureRect[3] = glyph.textureRect.height;
+        atlas.glyphs.push_back(baked);
+    }
+    atlas.kerning = m_kerning;
+    atlas.lineHeight = m_lineHeight;
+    atlas.pixels = m_pages[0].atlas.getPixels();
+    atlas.imageSize = m_pages[0].atlas.getSize();
+    atlas.channels = getChannelCount();
+    saveBakedAtlas(cacheFile, key, atlas);
+}
+
+void Font::addBitmapGlyphs(const std::u32string& codepoints)
+{
+    // The glyphs are rendered into CPU memory and packed here, so there is no
+    // round trip through a GL texture
+    m_rasterizer.setPixelSize(m_bitmapScale);
+
+    // Bake the metrics into a flat table, so laying out text does not have to
+    // go through FreeType for every character
+    for (auto codepoint : codepoints) {
+        GlyphBitmap bitmap = m_rasterizer.rasterize(codepoint);
+        sf::Glyph glyph;
+
+        glyph.advance = bitmap.advance;
+        glyph.bounds = {bitmap.left, bitmap.top,
+                        static_cast<float>(bitmap.width),
+                        static_cast<float>(bitmap.height)};
+        storeGlyph(codepoint, glyph, bitmap.pixels.data(), bitmap.width,
+                   bitmap.height);
     }
-    const sf::Texture& temp = m_font.getTexture(bitmapScale);
-    sf::Image bitmap = temp.copyToImage();
-    assert(bitmap.getSize().x == bitmap.getSize().y);
-    m_imageSize = bitmap.getSize().x;
-    m_texture.create(bitmap);
 }
 
-const sf::Glyph& Font::getGlyph(char character) const
+void Font::addDistanceFieldGlyphs(const std::u32string& codepoints)
 {
-    return m_font.getGlyph(character, m_bitmapScale, false);
+    // Rasterize the glyphs large, so the distance fields have sub-pixel
+    // precision once they are reduced to the bitmap scale
+    m_rasterizer.setPixelSize(m_bitmapScale * SDF_UPSCALE);
+
+    // The metrics are scaled down to the bitmap scale, and grown to include
+    // the padding around each distance field
+    float upscale = static_cast<float>(SDF_UPSCALE);
+    float spread = static_cast<float>(SDF_SPREAD);
+    for (auto codepoint : codepoints) {
+        GlyphBitmap source = m_rasterizer.rasterize(codepoint);
+        DistanceField field =
+            createDistanceField(source.pixels, source.width, source.height,
+                                SDF_UPSCALE, SDF_SPREAD);
+        sf::Glyph glyph;
+
+        glyph.advance = source.advance / upscale;
+        glyph.bounds.left = source.left / upscale - spread;
+        glyph.bounds.top = source.top / upscale - spread;
+        glyph.bounds.width = static_cast<float>(field.width);
+        glyph.bounds.height = static_cast<float>(field.height);
+        storeGlyph(codepoint, glyph, field.pixels.data(), field.width,
+                   field.height);
+    }
 }
 
+void Font::addMultiDistanceFieldGlyphs(const std::u32string& codepoints)
+{
+    // The fields are made straight from the glyph outlines, so unlike the
+    // single channel fields there is no need to rasterize them large first
+    if (!m_fontData) {
+        return;
+    }
+    std::vector<MultiDistanceField> fields = createMultiDistanceFields(
+        *m_fontData, codepoints, m_bitmapScale, SDF_SPREAD, *m_fieldPool);
+    if (fields.empty()) {
+        return;
+    }
+
+    m_rasterizer.setPixelSize(m_bitmapScale);
+    for (std::size_t i = 0; i < codepoints.size(); i++) {
+        const MultiDistanceField& field = fields[i];
+        sf::Glyph glyph;
 
-unsigned Font::getKerning(char before, char next) const
+        glyph.advance = m_rasterizer.getAdvance(codepoints[i]);
+        glyph.bounds = {field.left, field.top, static_cast<float>(field.width),
+                        static_cast<float>(field.height)};
+        storeGlyph(codepoints[i], glyph, field.pixels.data(), field.width,
+                   field.height);
+    }
+}
+
+void Font::createKerningTable()
+{
+    // The char set is small and fixed, so the kerning of every pair can be
+    // looked up once here, rather than through FreeType during layout
+    std::size_t count = m_charSet.size();
+    m_kerning.assign(count * count, 0.0f);
+    for (std::size_t before = 0; before < count; before++) {
+        for (std::size_t next = 0; next < count; next++) {
+            m_kerning[before * count + next] = m_rasterizer.getKerning(
+                static_cast<unsigned char>(m_charSet[before]),
+                static_cast<unsigned char>(m_charSet[next]));
+        }
+    }
+}
+
+const sf::Glyph& Font::getGlyph(char32_t codepoint) const
 {
-    return m_font.getKerning(before, next, m_bitmapScale);
+    if (isInCharSet(codepoint)) {
+        return m_glyphs[codepoint];
+    }
+    // Glyphs that have not been loaded map to the empty glyph at index 0
+    auto itr = m_extraGlyphs.find(codepoint);
+    if (itr != m_extraGlyphs.end()) {
+        return itr->second.glyph;
+    }
+    auto unplaceable = m_unplaceableGlyphs.find(codepoint);
+    return unplaceable != m_unplaceableGlyphs.end() ? unplaceable->second
+                                                    : m_glyphs[0];
+}
+
+unsigned Font::getGlyphPage(char32_t codepoint) const
+{
+    if (isInCharSet(codepoint)) {
+        return 0;
+    }
+    auto itr = m_extraGlyphs.find(codepoint);
+    return itr != m_extraGlyphs.end() ? itr->second.page : 0;
+}
+
+unsigned Font::getGlyphId(char32_t codepoint) const
+{
+    if (isInCharSet(codepoint)) {
+        return m_charIndices[codepoint] + 1;
+    }
+    auto itr = m_extraGlyphs.find(codepoint);
+    return itr != m_extraGlyphs.end() ? itr->second.id : 0;
+}
+
+void Font::bindGlyphTable(GLuint unit) const
+{
+    m_glyphTable.bind(unit);
+}
+
+void Font::uploadGlyphTable()
+{
+    if (m_glyphTableChanged) {
+        // The whole table is only built after a load. Rows of evicted glyphs
+        // are left as they are until their id is reused, as nothing laid out
+        // since refers to them
+        m_glyphTableChanged = false;
+        m_dirtyGlyphIds.clear();
+        m_glyphTableData.assign(static_cast<std::size_t>(m_glyphIdCount) * 8, 0);
+        writeGlyphRow(m_glyphTableData, 0, m_glyphs[0]);
+        for (std::size_t i = 0; i < m_charSet.size(); i++) {
+            writeGlyphRow(m_glyphTableData, i + 1,
+                          m_glyphs[static_cast<unsigned char>(m_charSet[i])]);
+        }
+        for (auto& glyph : m_extraGlyphs) {
+            writeGlyphRow(m_glyphTableData, glyph.second.id, glyph.second.glyph);
+        }
+        m_glyphTable.update(m_glyphTableData);
+        return;
+    }
+
+    // Otherwise only the rows added since the last upload are sent, one
+    // upload for each run of neighbouring rows
+    std::sort(m_dirtyGlyphIds.begin(), m_dirtyGlyphIds.end());
+    m_dirtyGlyphIds.erase(
+        std::unique(m_dirtyGlyphIds.begin(), m_dirtyGlyphIds.end()),
+        m_dirtyGlyphIds.end());
+    for (std::size_t i = 0; i < m_dirtyGlyphIds.size();) {
+        std::size_t end = i + 1;
+        while (end < m_dirtyGlyphIds.size() &&
+               m_dirtyGlyphIds[end] == m_dirtyGlyphIds[end - 1] + 1) {
+            end++;
+        }
+        std::size_t first = static_cast<std::size_t>(m_dirtyGlyphIds[i]) * 8;
+        m_glyphTable.update(m_glyphTableData, first, (end - i) * 8);
+        i = end;
+    }
+    m_dirtyGlyphIds.clear();
+}
+
+float Font::getKerning(char32_t before, char32_t next) const
+{
+    // Control characters are never drawn, so have no kerning. Checked first
+    // as newlines come up in most text
+    if (before < U' ' || next < U' ') {
+        return 0;
+    }
+    if (isInCharSet(before) && isInCharSet(next)) {
+        std::uint8_t row = m_charIndices[before];
+        std::uint8_t column = m_charIndices[next];
+        return m_kerning[row * m_charSet.size() + column];
+    }
+    // One of them is loaded on demand, and loadGlyphs opens FreeType for any
+    // glyph that is, so the pair is always read from the same place whether
+    // or not the font came from the baked cache
+    return m_rasterizer.getKerning(before, next);
 }
 
 unsigned Font::getLineHeight() const
 {
-    return m_font.getLineSpacing(m_bitmapScale);
+    return m_lineHeight;
 }
 
-void Font::bindTexture() const
+void Font::setAtlasBudget(std::size_t bytes)
 {
-    m_texture.bind();
+    m_atlasBudget = bytes;
 }
 
-unsigned Font::getTextureAtlasSize() const
+void Font::bindTexture(unsigned page) const
 {
-    return m_imageSize;
+    m_pages[page].atlas.bind();
+}
+
+const gl::Texture2d* Font::getTexture(unsigned page) const
+{
+    return m_pages[page].atlas.getTexture();
+}
+
+unsigned Font::getTextureAtlasSize(unsigned page) const
+{
+    return page < m_pages.size() ? m_pages[page].atlas.getSize() : 0;
+}
+
+unsigned Font::getPageCount() const
+{
+    return m_pages.size();
+}
+
+unsigned Font::getLayoutVersion() const
+{
+    return m_layoutVersion;
 }
 
 unsigned Font::getBitmapSize() const
@@ -115,20 +879,131 @@ unsigned Font::getBitmapSize() const
     return m_bitmapScale;
 }
 
+std::size_t Font::getTextureAtlasBytes() const
+{
+    if (!m_isLoaded) {
+        return 0;
+    }
+    std::size_t bytes = 0;
+    for (auto& page : m_pages) {
+        bytes += static_cast<std::size_t>(page.atlas.getSize()) *
+                 page.atlas.getSize() * page.atlas.getChannels();
+    }
+    for (auto& bucket : m_sizeBuckets) {
+        bytes += bucket.second->getTextureAtlasBytes();
+    }
+    return bytes;
+}
+
+float Font::getAtlasFillRatio() const
+{
+    if (!m_isLoaded) {
+        return 0;
+    }
+    // Weighted by the area of each page
+    float used = 0;
+    float area = 0;
+    for (auto& page : m_pages) {
+        float pageArea = static_cast<float>(page.atlas.getSize()) *
+                         static_cast<float>(page.atlas.getSize());
+        used += page.atlas.getFillRatio() * pageArea;
+        area += pageArea;
+    }
+    return area > 0 ? used / area : 0;
+}
+
+std::size_t Font::getAtlasUploadedBytes() const
+{
+    if (!m_isLoaded) {
+        return 0;
+    }
+    std::size_t bytes = 0;
+    for (auto& page : m_pages) {
+        bytes += page.atlas.getUploadedBytes();
+    }
+    return bytes;
+}
+
+float Font::getGlyphHitRate() const
+{
+    std::size_t lookups = m_glyphHits + m_glyphMisses;
+    return lookups > 0 ? static_cast<float>(m_glyphHits) / lookups : 1.0f;
+}
+
+std::size_t Font::getEvictedGlyphCount() const
+{
+    return m_evictedGlyphs;
+}
+
+std::size_t Font::getResidentGlyphCount() const
+{
+    return m_isLoaded ? m_charSet.size() + m_extraGlyphs.size() : 0;
+}
+
+unsigned Font::getChannelCount() const
+{
+    return m_type == FontType::MultiChannelSignedDistanceField ? 3 : 1;
+}
+
+std::size_t Font::getKerningTableBytes() const
+{
+    return m_kerning.size() * sizeof(float) +
+           m_charIndices.size() * sizeof(std::uint8_t);
+}
+
+std::size_t Font::getGlyphTableBytes() const
+{
+    return m_glyphTable.getBytes();
+}
+
 //  ===============================
 //      Text Class Implemenation
 //
-void Text::setFont(const Font& font)
+void Text::setFont(Font& font)
 {
     m_font = &font;
+    m_layoutFont = nullptr;
+    m_needsUpdate = true;
 }
 
 void Text::setText(const std::string& string)
 {
-    m_text = string;
+    m_text = decodeUtf8(string);
     m_needsUpdate = true;
 }
 
+void Text::setInstanced(bool instanced)
+{
+    m_isInstanced = instanced;
+    m_hasBuffers = false;
+    m_needsUpdate = true;
+}
+
+void Text::setStreamBuffer(gl::StreamBuffer* stream)
+{
+    m_stream = stream;
+    m_hasBuffers = false;
+    m_needsUpdate = true;
+}
+
+void Text::setGlyphBuffer(GlyphBuffer* buffer)
+{
+    m_glyphBuffer = buffer;
+    m_glyphRange = {};
+    m_hasBuffers = false;
+    m_needsUpdate = true;
+}
+
+bool Text::usesGlyphBuffer() const
+{
+    return m_glyphBuffer && !m_stream && !m_isInstanced;
+}
+
+std::chrono::microseconds Text::getLayoutTime() const
+{
+    return m_layoutTime;
+}
+
 void Text::setCharSize(float size)
 {
     m_scale = size;
@@ -139,56 +1014,310 @@ void Text::setPosition(const glm::vec3& position)
     m_position = position;
 }
 
-void Text::render(const gl::UniformLocation& location)
+Font* Text::updateLayout()
 {
-    m_font->bindTexture();
     if (!m_font) {
-        return;
+        return nullptr;
     }
-    if (m_needsUpdate) {
-        createGeometry();
+    // Small text is drawn from a smaller rasterization of the font, once it
+    // has been built. Nothing is drawn until some size has finished loading
+    Font* font = &m_font->getSizeBucket(m_scale);
+    if (!font->isLoaded()) {
+        font = m_font;
     }
-    glm::mat4 modelMatrix {1.0f};
-    float scale = m_scale / m_font->getBitmapSize();
+    if (!font->isLoaded()) {
+        return nullptr;
+    }
+
+    // Glyphs move when an atlas page grows or is evicted, so the text has to
+    // be laid out again whenever the font's layout changes. The version is
+    // what is compared, as a replaced font can reuse the old one's address
+    if (m_needsUpdate || m_layoutVersion != font->getLayoutVersion()) {
+        m_layoutFont = font;
+        layoutGlyphs();
+    }
+    return m_layoutFont;
+}
+
+const std::vector<Text::PlacedGlyph>& Text::getGlyphs() const
+{
+    return m_glyphs;
+}
 
+glm::mat4 Text::getModelMatrix() const
+{
+    glm::mat4 modelMatrix {1.0f};
     translateMatrix(modelMatrix, m_position);
     rotateMatrix(modelMatrix, {180.0f, 0.0f, 0.0f});
-    scaleMatrix(modelMatrix, scale);
+    if (m_layoutFont) {
+        scaleMatrix(modelMatrix, m_scale / m_layoutFont->getBitmapSize());
+    }
+    return modelMatrix;
+}
+
+void Text::render(const gl::UniformLocation& location)
+{
+    if (!updateGeometry()) {
+        return;
+    }
+    gl::loadUniform(location, getDrawMatrix());
+
+    // One draw for each atlas page the text uses
+    auto drawable = getDrawable();
+    GLint baseVertex = getBaseVertex();
+    drawable.bind();
+    if (m_isInstanced) {
+        m_layoutFont->bindGlyphTable(GLYPH_TABLE_UNIT);
+    }
+    for (auto& section : m_pageSections) {
+        m_layoutFont->touchPage(section.page);
+        m_layoutFont->bindTexture(section.page);
+        if (m_isInstanced) {
+            m_vao.setFirstInstance(section.first);
+            drawable.drawInstances(4, section.count);
+        }
+        else {
+            drawable.drawSection(section.first, section.count, baseVertex);
+        }
+    }
+}
+
+void Text::addTo(gl::DrawList& list)
+{
+    if (m_isInstanced || !updateGeometry()) {
+        return;
+    }
+    glm::mat4 modelMatrix = getDrawMatrix();
+    for (auto& section : m_pageSections) {
+        m_layoutFont->touchPage(section.page);
+        auto texture = m_layoutFont->getTexture(section.page);
+        if (usesGlyphBuffer()) {
+            // Texts added after this one can still move the range, or widen
+            // the indices of the buffer, before the list is submitted. The
+            // matrix goes with the range, so is not part of the draw
+            m_glyphRange.setTransform(modelMatrix);
+            list.add(m_glyphRange, {section.count, section.first, 0},
+                     texture);
+        }
+        else {
+            list.add(m_vao.getDrawable(),
+                     {section.count, section.first, m_baseVertex},
+                     modelMatrix, texture);
+        }
+    }
+}
 
-    gl::loadUniform(location, modelMatrix);
+bool Text::updateGeometry()
+{
+    if (!updateLayout()) {
+        return false;
+    }
+    // Dynamic text also has to be written again once the stream buffer has
+    // thrown its old contents away, or if it could not be written last time
+    if (m_needsUpload ||
+        (m_stream && (!m_isStreamWritten ||
+                      m_streamGeneration != m_stream->getGeneration()))) {
+        createGeometry();
+    }
+    return true;
+}
 
-    m_vao.getDrawable().bindAndDraw();
+glm::mat4 Text::getDrawMatrix() const
+{
+    glm::mat4 modelMatrix = getModelMatrix();
+    if (!m_isInstanced) {
+        // Quad vertices are stored in fractions of a pixel
+        scaleMatrix(modelMatrix, 1.0f / m_subpixels);
+    }
+    return modelMatrix;
 }
 
+gl::Drawable Text::getDrawable() const
+{
+    return usesGlyphBuffer() ? m_glyphBuffer->getDrawable() : m_vao.getDrawable();
+}
 
+GLint Text::getBaseVertex() const
+{
+    return usesGlyphBuffer() ? m_glyphRange.getBaseVertex() : m_baseVertex;
+}
 
-void Text::createGeometry()
+void Text::layoutGlyphs()
 {
-    m_vao.destroy();
-    Mesh mesh;
+    auto start = std::chrono::steady_clock::now();
     m_needsUpdate = false;
+    m_needsUpload = true;
 
-    sf::Vector2f pos{0, m_scale};
-    char previous = 0;
+    m_layoutFont->loadGlyphs(m_text);
+    m_layoutVersion = m_layoutFont->getLayoutVersion();
+    m_glyphs.clear();
+
+    // The first baseline is one bitmap size down, which is the same height
+    // on screen whichever size the text is laid out with
+    sf::Vector2f pos{0, static_cast<float>(m_layoutFont->getBitmapSize())};
+    char32_t previous = 0;
     for (auto character : m_text) {
-        pos.x += m_font->getKerning(previous, character);
+        pos.x += m_layoutFont->getKerning(previous, character);
         previous = character;
 
         //New line handler
-        if (character == '\n') {
-            pos.y += m_font->getLineHeight();
+        if (character == U'\n') {
+            pos.y += m_layoutFont->getLineHeight();
             pos.x = 0;
         }
 
-        //Create a single quad for the char
-        auto& glyph = m_font->getGlyph(character);
-        addCharacter(mesh, glyph, m_font->getTextureAtlasSize(), pos);
+        //Create a single quad for the char, unless there is nothing to see
+        auto& glyph = m_layoutFont->getGlyph(character);
+        if (glyph.bounds.width > 0 && glyph.bounds.height > 0) {
+            m_glyphs.push_back({m_layoutFont->getGlyphPage(character),
+                                m_layoutFont->getGlyphId(character), &glyph,
+                                pos});
+        }
         pos.x += glyph.advance;
     }
 
-    m_vao.create();
-    m_vao.bind();
-    m_vao.addVertexBuffer(2, mesh.vertices);
-    m_vao.addVertexBuffer(2, mesh.textureCoords);
-    m_vao.addIndexBuffer(mesh.indices);
-}
\ No newline at end of file
+    // Glyphs are grouped by page, so each page can be drawn in one go
+    std::stable_sort(m_glyphs.begin(), m_glyphs.end(),
+                     [](const PlacedGlyph& a, const PlacedGlyph& b) {
+                         return a.page < b.page;
+                     });
+
+    m_layoutTime = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+}
+
+void Text::createGeometry()
+{
+    auto start = std::chrono::steady_clock::now();
+    bool isNewLayout = m_needsUpload;
+    m_needsUpload = false;
+
+    // Dynamic text writes its quads straight into the stream buffer, rather
+    // than building them up and then uploading them
+    bool isStreamed = m_stream && !m_isInstanced;
+    std::vector<TextVertex> vertices;
+    TextVertex* quadVertices = nullptr;
+    m_baseVertex = 0;
+    if (isStreamed) {
+        std::size_t offset = 0;
+        quadVertices = static_cast<TextVertex*>(
+            m_stream->map(m_glyphs.size() * 4 * sizeof(TextVertex),
+                          sizeof(TextVertex), offset));
+        m_baseVertex = static_cast<GLint>(offset / sizeof(TextVertex));
+        m_streamGeneration = m_stream->getGeneration();
+    }
+    else if (!m_isInstanced) {
+        vertices.resize(m_glyphs.size() * 4);
+        quadVertices = vertices.data();
+    }
+
+    // As many subpixels as fit the furthest corner of the text in 16 bits,
+    // so long text loses precision rather than being squashed at the limit
+    float extent = 0;
+    for (auto& glyph : m_glyphs) {
+        auto& bounds = glyph.glyph->bounds;
+        extent = std::max({extent, std::abs(glyph.position.x + bounds.left),
+                           std::abs(glyph.position.x + bounds.left + bounds.width),
+                           std::abs(glyph.position.y + bounds.top),
+                           std::abs(glyph.position.y + bounds.top + bounds.height)});
+    }
+    m_subpixels = std::min(POSITION_SUBPIXELS, MAX_PACKED_POSITION / std::max(extent, 1.0f));
+
+    m_pageSections.clear();
+    std::vector<GLfloat> penPositions;
+    std::vector<GLuint> glyphIds;
+    for (std::size_t i = 0; i < m_glyphs.size(); i++) {
+        auto& glyph = m_glyphs[i];
+        auto first = static_cast<GLsizei>(m_isInstanced ? i : i * 6);
+        if (m_pageSections.empty() || m_pageSections.back().page != glyph.page) {
+            m_pageSections.push_back({glyph.page, first, 0});
+        }
+        if (m_isInstanced) {
+            penPositions.insert(penPositions.end(),
+                                {glyph.position.x, glyph.position.y});
+            glyphIds.push_back(glyph.glyphId);
+            m_pageSections.back().count++;
+        }
+        else {
+            if (quadVertices) {
+                addCharacter(quadVertices + i * 4, *glyph.glyph,
+                             m_layoutFont->getTextureAtlasSize(glyph.page),
+                             glyph.position, m_subpixels);
+            }
+            m_pageSections.back().count += 6;
+        }
+    }
+    if (isStreamed && !m_glyphs.empty()) {
+        // If the quads did not get written, drawing would show whatever was
+        // in that part of the buffer before, so nothing is drawn until they
+        // are written again
+        m_isStreamWritten = quadVertices && m_stream->unmap();
+        if (!m_isStreamWritten) {
+            m_pageSections.clear();
+        }
+    }
+    else {
+        m_isStreamWritten = true;
+    }
+
+    // The buffers are made once and then only updated, from the first
+    // glyph that changed, so text that changes every frame does not make new
+    // GL objects every frame
+    if (usesGlyphBuffer()) {
+        std::size_t firstChanged = commonPrefix(vertices, m_vertices) / 4;
+        if (m_glyphRange.getQuadCapacity() < m_glyphs.size()) {
+            // Grown geometrically, the same as a buffer of its own
+            std::size_t capacity =
+                std::max(m_glyphs.size(), m_glyphRange.getQuadCapacity() * 2);
+            m_glyphRange = {};
+            m_glyphRange = m_glyphBuffer->allocate(capacity);
+            firstChanged = 0;
+        }
+        m_glyphRange.write(vertices.data(), m_glyphs.size(), firstChanged);
+        m_glyphBuffer->reserveIndices(m_glyphs.size());
+    }
+    else if (!m_hasBuffers) {
+        m_vao.destroy();
+        m_vao.create();
+        m_vao.bind();
+        if (m_isInstanced) {
+            // 12 bytes a glyph, where the quad path takes 32
+            m_vao.addSharedVertexBuffer(2, getUnitQuadBuffer());
+            m_vao.addInstanceBuffer(2, penPositions);
+            m_vao.addInstanceBuffer(1, glyphIds);
+        }
+        else if (isStreamed) {
+            m_vao.addSharedVertexBuffer(TEXT_VERTEX_LAYOUT, sizeof(TextVertex),
+                                        m_stream->getHandle());
+        }
+        else {
+            m_vao.addVertexBuffer(TEXT_VERTEX_LAYOUT, vertices);
+        }
+        m_hasBuffers = true;
+    }
+    else if (m_isInstanced) {
+        m_vao.updateBuffer(0, penPositions,
+                           commonPrefix(penPositions, m_penPositions));
+        m_vao.updateBuffer(1, glyphIds, commonPrefix(glyphIds, m_glyphIds));
+    }
+    else if (!isStreamed) {
+        m_vao.updateBuffer(0, vertices, commonPrefix(vertices, m_vertices));
+    }
+    if (!m_isInstanced && !usesGlyphBuffer()) {
+        // Cheap to do every time, and the index type changes if the text
+        // grows past what 16 bit indices can reach
+        GLenum indexType;
+        GLuint indices = getQuadIndexBuffer(m_glyphs.size(), indexType);
+        m_vao.addSharedIndexBuffer(indices, indexType);
+    }
+    m_vertices = std::move(vertices);
+    m_penPositions = std::move(penPositions);
+    m_glyphIds = std::move(glyphIds);
+
+    // Writing the same layout again, after the stream buffer was thrown away,
+    // is not a layout, so only counts straight after one
+    if (isNewLayout) {
+        m_layoutTime += std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start);
+    }
+}
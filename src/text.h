@@ -1,56 +1,428 @@
 #pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
 #include <glm/gtc/matrix_transform.hpp>
-#include <SFML/Graphics/Font.hpp>
+#include <SFML/Graphics/Glyph.hpp>
+#include "glyph_atlas.h"
+#include "glyph_buffer.h"
+#include "glyph_rasterizer.h"
 #include "gl/textures.h"
 #include "gl/vertex_array.h"
 
+struct BakedAtlasKey;
+class MappedFile;
+class ThreadPool;
+
 namespace gl
 {
+    class DrawList;
     class Shader;
+    class StreamBuffer;
     struct UniformLocation;
 } // namespace gl
 
 
+/**
+ * @brief How the glyphs of a font are stored in its texture atlas
+ */
+enum class FontType
+{
+    // Glyph coverage, rasterized at the bitmap scale
+    Bitmap,
+
+    // Signed distance to the glyph edges, scales cleanly to any size
+    SignedDistanceField,
+
+    // Distance to the glyph edges across three channels, which unlike a
+    // single distance field also keeps corners sharp
+    MultiChannelSignedDistanceField,
+};
+
 class Font
 {
     public:
-        void init(const std::string& fontFile, unsigned bitmapScale);
-        const sf::Glyph& getGlyph(char character) const;
+        Font();
+        ~Font();
+
+        void init(const std::string& fontFile, unsigned bitmapScale,
+                  FontType type = FontType::Bitmap);
+
+        /**
+         * @brief Loads the font on a worker thread. The atlas is uploaded by
+         * the first update() after the worker is done, and until then the
+         * font is not loaded and text using it draws nothing
+         */
+        void initAsync(const std::string& fontFile, unsigned bitmapScale,
+                       FontType type = FontType::Bitmap);
+        bool isLoaded() const;
+
+        // Blocks until a load started by initAsync has finished, then
+        // uploads the atlas. Must be called on the GL thread
+        void waitUntilLoaded();
+
+        /**
+         * @brief Gets the rasterized size of this font that best suits text
+         * drawn at a char size. Sizes below the bitmap scale are loaded in
+         * the background the first time they are asked for. Only bitmap
+         * fonts have smaller sizes
+         *
+         * @param charSize The size the text is drawn at
+         * @return Font& The font for that size. This font if the char size is
+         * at least the bitmap scale, or there is no smaller size to use
+         */
+        Font& getSizeBucket(float charSize);
+        /**
+         * @brief Rasterizes any of the codepoints that are not in the atlas
+         * yet. Glyphs outside of the char set are only loaded this way, so
+         * they only take up space once they are used
+         */
+        void loadGlyphs(const std::u32string& codepoints);
+
+        const sf::Glyph& getGlyph(char32_t codepoint) const;
+        unsigned getGlyphPage(char32_t codepoint) const;
+
+        /**
+         * @brief Gets the row of a glyph in the glyph table. Glyphs that are
+         * not loaded get row 0, which is an empty glyph
+         */
+        unsigned getGlyphId(char32_t codepoint) const;
+
+        /**
+         * @brief Binds the glyph table, which holds two texels for each
+         * glyph id: its bounds, then its rect in its atlas page in pixels.
+         * Being in pixels, the rects stay valid when a page grows
+         */
+        void bindGlyphTable(GLuint unit) const;
         
-        unsigned getKerning(char before, char next) const;
+        // Pairs in the char set come from a table, other printable pairs
+        // from FreeType, and pairs with a control character are always 0
+        float getKerning(char32_t before, char32_t next) const;
         unsigned getLineHeight() const;
 
-        void bindTexture() const;
+        // Starts a new frame of atlas counters, and uploads anything pending
+        void update();
+
+        /**
+         * @brief Limits the memory used by the atlas pages. Once it is used
+         * up, the page that was drawn from least recently is emptied to make
+         * room for new glyphs. The char set page is never evicted
+         */
+        void setAtlasBudget(std::size_t bytes);
+
+        // True once the pages in use at the same time no longer fit the
+        // budget, in which case new pages are made anyway
+        bool isOverAtlasBudget() const;
+
+        // Marks a page as drawn from this frame, so it is not evicted
+        void touchPage(unsigned page);
+        void bindTexture(unsigned page = 0) const;
+        const gl::Texture2d* getTexture(unsigned page = 0) const;
 
-        unsigned getTextureAtlasSize() const;
+        /**
+         * @brief Changes whenever glyphs already in the atlas are moved or
+         * evicted, meaning anything laid out before has to be laid out again.
+         * No two fonts share a version, so it also changes when a font is
+         * replaced
+         */
+        unsigned getLayoutVersion() const;
+
+        unsigned getTextureAtlasSize(unsigned page = 0) const;
+        unsigned getPageCount() const;
         unsigned getBitmapSize() const;
+        std::size_t getTextureAtlasBytes() const;
+        std::size_t getKerningTableBytes() const;
+        std::size_t getGlyphTableBytes() const;
+
+        // How much of the atlas is covered by glyphs, between 0 and 1
+        float getAtlasFillRatio() const;
+
+        // Bytes of atlas sent to the GPU since the last update
+        std::size_t getAtlasUploadedBytes() const;
+
+        // The share of glyph lookups when laying out text that were already
+        // in the atlas
+        float getGlyphHitRate() const;
+        std::size_t getEvictedGlyphCount() const;
+        std::size_t getResidentGlyphCount() const;
 
     private:
-        sf::Font m_font;
-        gl::Texture2d m_texture;
+        // The parts of loading that do not need OpenGL
+        void load();
+        void finishLoading();
+
+        struct FontPage
+        {
+            GlyphAtlas atlas;
+            std::uint64_t lastUsed = 0;
+        };
+
+        struct PagedGlyph
+        {
+            sf::Glyph glyph;
+            unsigned page = 0;
+            unsigned id = 0;
+        };
+
+        void addGlyphs(const std::u32string& codepoints);
+        void addBitmapGlyphs(const std::u32string& codepoints);
+        void addDistanceFieldGlyphs(const std::u32string& codepoints);
+        void addMultiDistanceFieldGlyphs(const std::u32string& codepoints);
+        bool isInCharSet(char32_t codepoint) const;
+        bool hasGlyph(char32_t codepoint) const;
+        void storeGlyph(char32_t codepoint, sf::Glyph glyph,
+                        const std::uint8_t* pixels, unsigned width,
+                        unsigned height);
+        void addExtraGlyph(char32_t codepoint, const sf::Glyph& glyph,
+                           unsigned page);
+        bool addToPage(unsigned page, const std::uint8_t* pixels,
+                       unsigned width, unsigned height, sf::IntRect& rect);
+        void createPage(unsigned maxSize);
+        std::size_t getPageBytes() const;
+        unsigned findEvictablePage() const;
+        void evictPage(unsigned page);
+        void createKerningTable();
+        void uploadGlyphTable();
+        void createAtlas();
+        unsigned getChannelCount() const;
+
+        bool readBakedAtlas(const std::string& cacheFile,
+                            const BakedAtlasKey& key);
+        void writeBakedAtlas(const std::string& cacheFile,
+                             const BakedAtlasKey& key) const;
+
+        GlyphRasterizer m_rasterizer;
+        // Page 0 holds the char set, the rest hold glyphs loaded on demand
+        std::vector<FontPage> m_pages;
+
+        // Glyph metrics for the char set, indexed by codepoint
+        std::array<sf::Glyph, 128> m_glyphs;
+
+        // Position of each codepoint in the char set, or NO_CHAR_INDEX
+        std::array<std::uint8_t, 128> m_charIndices;
+
+        // Glyphs outside of the char set, loaded as they are first used
+        std::unordered_map<char32_t, PagedGlyph> m_extraGlyphs;
+
+        // Glyphs too large for a page, kept without an image so they are not
+        // rasterized again on every layout
+        std::unordered_map<char32_t, sf::Glyph> m_unplaceableGlyphs;
+
+        // Rows of the glyph table. Row 0 is the empty glyph, the char set
+        // follows in order, and the rest are handed out to extra glyphs
+        gl::BufferTexture m_glyphTable;
+
+        // What the glyph table holds, and the rows that changed since it was
+        // last uploaded
+        std::vector<GLfloat> m_glyphTableData;
+        std::vector<unsigned> m_dirtyGlyphIds;
+        std::vector<unsigned> m_freeGlyphIds;
+        unsigned m_glyphIdCount = 0;
+        bool m_glyphTableChanged = false;
+
+        // Dense char set size * char set size kerning matrix
+        std::vector<float> m_kerning;
+
+        // Smaller rasterizations of this font, keyed by bitmap scale
+        std::map<unsigned, std::unique_ptr<Font>> m_sizeBuckets;
+
+        std::string m_fontFile;
+        std::shared_ptr<const MappedFile> m_fontData;
+
+        // Makes multi-channel distance fields. Kept for the life of the font,
+        // as glyphs loaded later on the GL thread use it too
+        std::unique_ptr<ThreadPool> m_fieldPool;
         unsigned m_bitmapScale = 0;
-        unsigned m_imageSize = 0;
-        const std::string m_charSet = "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ.,!?-+/()[]:;%&`*#=\"";
+        float m_lineHeight = 0;
+        FontType m_type = FontType::Bitmap;
+
+        std::size_t m_atlasBudget = 16 * 1024 * 1024;
+        std::uint64_t m_frame = 0;
+        unsigned m_layoutVersion = 0;
+        std::size_t m_glyphHits = 0;
+        std::size_t m_glyphMisses = 0;
+        std::size_t m_evictedGlyphs = 0;
+        bool m_hasWarnedAtlasBudget = false;
+        const std::string m_charSet = " 0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ.,!?-+/()[]:;%&`*#=\"";
+
+        // Only written by the GL thread, once a load has finished
+        bool m_isLoaded = false;
+
+        // Declared last, so that a load still running is waited for before
+        // anything it uses is destroyed
+        std::future<void> m_loading;
 };
 
+/**
+ * @brief A vertex of a text quad in 8 bytes, where a float position and
+ * texture coord would take 16
+ */
+struct TextVertex
+{
+    std::int16_t x;
+    std::int16_t y;
+    std::uint16_t u;
+    std::uint16_t v;
+};
+
+// The attributes of a TextVertex, for setting up a vertex array
+const std::vector<gl::VertexAttribute>& getTextVertexLayout();
+
+/**
+ * @brief Gets the part of an atlas page a glyph is drawn from, in texture
+ * coords, including the padding around the glyph
+ */
+sf::FloatRect getGlyphTextureRect(const sf::Glyph& glyph, float atlasSize);
+
 class Text final
 {
     public:
-        void setFont(const Font& font);
+        // The texture unit the glyph table is bound to for instanced text
+        static constexpr GLuint GLYPH_TABLE_UNIT = 1;
+
+        /**
+         * @brief Draws each glyph as an instance of a shared quad, which is
+         * only a pen position and a glyph id, rather than as four vertices.
+         * Needs the "glyph" vertex shader, with its glyphTable sampler set to
+         * GLYPH_TABLE_UNIT
+         */
+        void setInstanced(bool instanced);
+
+        /**
+         * @brief Marks the text as dynamic, for text that changes most
+         * frames. Its quads are then written straight into the stream
+         * buffer instead of into a buffer of its own. Instanced text ignores
+         * this. Pass nullptr to make the text static again
+         *
+         * Many texts can share a stream buffer. Its beginFrame() has to be
+         * called each frame before any of them are drawn, and not again
+         * until the draw lists they were added to are submitted
+         */
+        void setStreamBuffer(gl::StreamBuffer* stream);
+
+        /**
+         * @brief Puts the quads of the text in a range of a buffer shared
+         * with other texts, rather than a buffer of its own, so that drawing
+         * many texts does not switch vertex arrays. Ignored by instanced and
+         * dynamic text. Pass nullptr to go back to a buffer of its own
+         */
+        void setGlyphBuffer(GlyphBuffer* buffer);
+
+        void setFont(Font& font);
         void setText(const std::string& string);
         void setCharSize(float size);
         void setPosition(const glm::vec3& position);
 
+        /**
+         * @brief Draws the text now, loading its model matrix into a
+         * uniform. Used for instanced text, as shaders drawn through a draw
+         * list read their model matrices from a uniform buffer instead
+         */
         void render(const gl::UniformLocation& location);
 
+        /**
+         * @brief Adds the draws of the text to a draw list instead of
+         * drawing it now. Instanced text is not added, and has to be drawn
+         * with render(). The text must stay alive until the list is
+         * submitted
+         *
+         * Texts that share a glyph buffer are drawn together whatever their
+         * model matrices, and need a shader that reads the buffer's
+         * transforms. Other texts need one that reads "Transforms"
+         */
+        void addTo(gl::DrawList& list);
+
+        /**
+         * @brief A glyph of the text, once it has been laid out
+         */
+        struct PlacedGlyph
+        {
+            unsigned page;
+            unsigned glyphId;
+            const sf::Glyph* glyph;
+
+            // The pen position, in pixels of the layout font's bitmap size
+            sf::Vector2f position;
+        };
+
+        /**
+         * @brief Lays the text out again if it, or its font, has changed
+         *
+         * @return Font* The size of the font the text is laid out with, or
+         * nullptr if no size of the font has loaded yet
+         */
+        Font* updateLayout();
+
+        // The glyphs of the last layout, sorted by atlas page
+        const std::vector<PlacedGlyph>& getGlyphs() const;
+
+        // Takes the laid out glyphs to where the text is in the world
+        glm::mat4 getModelMatrix() const;
+
+        // CPU time taken by the last layout, which happens when the text or
+        // its font changes
+        std::chrono::microseconds getLayoutTime() const;
+
     private:
+        // Lays out and uploads the text if needed, false if it cannot be
+        // drawn yet
+        bool updateGeometry();
+        void layoutGlyphs();
         void createGeometry();
+        glm::mat4 getDrawMatrix() const;
+        gl::Drawable getDrawable() const;
+        GLint getBaseVertex() const;
+        bool usesGlyphBuffer() const;
 
-        std::string m_text;
+        std::u32string m_text;
         gl::VertexArray m_vao;
         float m_scale = 0;
-        const Font* m_font = nullptr;
+        Font* m_font = nullptr;
+
+        // The size bucket of m_font that the text was last laid out with
+        Font* m_layoutFont = nullptr;
+        unsigned m_layoutVersion = 0;
+
+        // The range of indices, or of instances, drawn with each atlas page
+        struct PageSection
+        {
+            unsigned page;
+            GLsizei first;
+            GLsizei count;
+        };
+        std::vector<PageSection> m_pageSections;
+        std::vector<PlacedGlyph> m_glyphs;
         bool m_needsUpdate = false;
+        bool m_needsUpload = false;
+        bool m_isStreamWritten = true;
+        bool m_isInstanced = false;
+
+        // What the buffers hold, so that a new layout only sends what
+        // changed
+        std::vector<TextVertex> m_vertices;
+        std::vector<GLfloat> m_penPositions;
+        std::vector<GLuint> m_glyphIds;
+        bool m_hasBuffers = false;
+
+        // The fraction of a pixel that quad positions are stored in
+        float m_subpixels = 1;
+
+        // Where dynamic text is written, and where in it the text starts
+        gl::StreamBuffer* m_stream = nullptr;
+        unsigned m_streamGeneration = 0;
+        GLint m_baseVertex = 0;
+
+        // Where the text is kept when it shares a glyph buffer
+        GlyphBuffer* m_glyphBuffer = nullptr;
+        GlyphRange m_glyphRange;
+
+        std::chrono::microseconds m_layoutTime {0};
 
         glm::vec3 m_position;
 };
\ No newline at end of file
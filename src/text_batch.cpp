@@ -0,0 +1,191 @@
+#include "text_batch.h"
+
+#include "gl/primitive.h"
+#include "text.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <utility>
+
+namespace {
+// Batched glyphs are already in world space, so positions need floats
+struct BatchVertex {
+    GLfloat x;
+    GLfloat y;
+    std::uint16_t u;
+    std::uint16_t v;
+};
+
+const std::vector<gl::VertexAttribute> BATCH_VERTEX_LAYOUT = {
+    {2, GL_FLOAT},
+    {2, GL_UNSIGNED_SHORT, true},
+};
+
+// The stream grows to fit a frame of glyphs if this is not enough
+constexpr std::size_t INITIAL_STREAM_BYTES = 4 * 1024 * 1024;
+
+std::uint16_t packTextureCoord(float coord)
+{
+    return static_cast<std::uint16_t>(
+        std::round(std::clamp(coord, 0.0f, 1.0f) * 65535.0f));
+}
+
+// The glyphs of one font size that are on one atlas page, which is what one
+// draw call can cover
+struct Group {
+    std::size_t quadCount = 0;
+    std::size_t firstQuad = 0;
+    std::size_t written = 0;
+};
+using GroupKey = std::pair<Font *, unsigned>;
+} // namespace
+
+void TextBatch::add(Text &text)
+{
+    m_texts.push_back(&text);
+}
+
+void TextBatch::addTo(gl::DrawList &list)
+{
+    m_textCount = 0;
+    m_glyphCount = 0;
+    m_drawCallCount = 0;
+
+    // Lay out every text and count the glyphs in each group first, so each
+    // group can be written as one run. Pages are marked as used as they are
+    // found, so laying out later texts cannot evict them
+    struct Entry {
+        Text *text;
+        Font *font;
+    };
+    std::vector<Entry> entries;
+    std::map<GroupKey, Group> groups;
+    for (auto text : m_texts) {
+        Font *font = text->updateLayout();
+        if (!font) {
+            continue;
+        }
+        for (auto &glyph : text->getGlyphs()) {
+            groups[{font, glyph.page}].quadCount++;
+            font->touchPage(glyph.page);
+        }
+        entries.push_back({text, font});
+    }
+    m_texts.clear();
+
+    std::size_t quadCount = 0;
+    std::size_t largestGroup = 0;
+    for (auto &group : groups) {
+        group.second.firstQuad = quadCount;
+        quadCount += group.second.quadCount;
+        largestGroup = std::max(largestGroup, group.second.quadCount);
+    }
+    if (quadCount == 0) {
+        return;
+    }
+
+    if (!m_stream.getHandle()) {
+        m_stream.create(INITIAL_STREAM_BYTES);
+        m_vao.create();
+        m_vao.bind();
+        m_vao.addSharedVertexBuffer(BATCH_VERTEX_LAYOUT, sizeof(BatchVertex),
+                                    m_stream.getHandle());
+    }
+    // The draws of the last addTo have been submitted by now
+    m_stream.beginFrame();
+    std::size_t offset = 0;
+    auto vertices = static_cast<BatchVertex *>(
+        m_stream.map(quadCount * 4 * sizeof(BatchVertex), sizeof(BatchVertex),
+                     offset));
+    if (!vertices) {
+        return;
+    }
+
+    for (auto &entry : entries) {
+        // Only the 2D part of the transform is needed, as z is dropped
+        glm::mat4 model = entry.text->getModelMatrix();
+        float xx = model[0][0];
+        float xy = model[0][1];
+        float yx = model[1][0];
+        float yy = model[1][1];
+        float tx = model[3][0];
+        float ty = model[3][1];
+
+        Group *group = nullptr;
+        unsigned page = 0;
+        float atlasSize = 0;
+        for (auto &glyph : entry.text->getGlyphs()) {
+            // Glyphs are sorted by page, so the group only changes a few
+            // times for each text
+            if (!group || glyph.page != page) {
+                page = glyph.page;
+                group = &groups[{entry.font, page}];
+                atlasSize = entry.font->getTextureAtlasSize(page);
+            }
+            auto &bounds = glyph.glyph->bounds;
+            float left = glyph.position.x + bounds.left;
+            float top = glyph.position.y + bounds.top;
+            float right = left + bounds.width;
+            float bottom = top + bounds.height;
+            sf::FloatRect texRect = getGlyphTextureRect(*glyph.glyph, atlasSize);
+            std::uint16_t texLeft = packTextureCoord(texRect.left);
+            std::uint16_t texTop = packTextureCoord(texRect.top);
+            std::uint16_t texRight = packTextureCoord(texRect.left + texRect.width);
+            std::uint16_t texBottom =
+                packTextureCoord(texRect.top + texRect.height);
+
+            BatchVertex *quad =
+                vertices + (group->firstQuad + group->written++) * 4;
+            auto corner = [&](BatchVertex &vertex, float x, float y,
+                              std::uint16_t u, std::uint16_t v) {
+                vertex.x = xx * x + yx * y + tx;
+                vertex.y = xy * x + yy * y + ty;
+                vertex.u = u;
+                vertex.v = v;
+            };
+            corner(quad[0], left, top, texLeft, texTop);
+            corner(quad[1], right, top, texRight, texTop);
+            corner(quad[2], right, bottom, texRight, texBottom);
+            corner(quad[3], left, bottom, texLeft, texBottom);
+        }
+        m_glyphCount += entry.text->getGlyphs().size();
+        m_textCount++;
+    }
+    if (!m_stream.unmap()) {
+        // Written again next frame
+        return;
+    }
+
+    GLenum indexType;
+    GLuint indices = getQuadIndexBuffer(largestGroup, indexType);
+    m_vao.addSharedIndexBuffer(indices, indexType);
+
+    // The glyphs are already in world space
+    auto drawable = m_vao.getDrawable();
+    auto baseVertex = static_cast<GLint>(offset / sizeof(BatchVertex));
+    for (auto &group : groups) {
+        list.add(drawable,
+                 {static_cast<GLsizei>(group.second.quadCount * 6), 0,
+                  baseVertex + static_cast<GLint>(group.second.firstQuad * 4)},
+                 glm::mat4{1.0f},
+                 group.first.first->getTexture(group.first.second));
+        m_drawCallCount++;
+    }
+}
+
+std::size_t TextBatch::getTextCount() const
+{
+    return m_textCount;
+}
+
+std::size_t TextBatch::getGlyphCount() const
+{
+    return m_glyphCount;
+}
+
+std::size_t TextBatch::getDrawCallCount() const
+{
+    return m_drawCallCount;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "gl/draw_list.h"
+#include "gl/stream_buffer.h"
+#include "gl/vertex_array.h"
+
+#include <cstddef>
+#include <vector>
+
+class Text;
+
+/**
+ * @brief Draws many texts at once. The glyphs of every queued text are moved
+ * into world space on the CPU and written into one vertex stream, so all the
+ * texts using the same font size are drawn with a single draw call for each
+ * atlas page, whatever the number of texts.
+ *
+ * Drawn through a draw list with the model matrix set to identity. Texts
+ * are drawn flat at z = 0
+ */
+class TextBatch final {
+  public:
+    // Queues a text for the next addTo. It must stay alive until then
+    void add(Text &text);
+
+    /**
+     * @brief Writes everything queued, adds the draws for it to a draw list,
+     * then empties the queue. The list must be submitted before the next
+     * addTo, as the writes go into a stream buffer
+     */
+    void addTo(gl::DrawList &list);
+
+    // What the last addTo wrote, and the draw calls it takes to draw it
+    std::size_t getTextCount() const;
+    std::size_t getGlyphCount() const;
+    std::size_t getDrawCallCount() const;
+
+  private:
+    gl::VertexArray m_vao;
+    gl::StreamBuffer m_stream;
+    std::vector<Text *> m_texts;
+
+    std::size_t m_textCount = 0;
+    std::size_t m_glyphCount = 0;
+    std::size_t m_drawCallCount = 0;
+};
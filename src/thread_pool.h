@@ -0,0 +1,53 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief A fixed set of worker threads that run tasks from a shared queue
+ */
+class ThreadPool final {
+  public:
+    /**
+     * @brief Starts the worker threads
+     *
+     * @param threadCount How many workers to start, 0 uses one per hardware
+     * thread
+     */
+    explicit ThreadPool(unsigned threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /**
+     * @brief Queues a task to be ran by the first free worker
+     *
+     * @param task The task to run
+     */
+    void addTask(std::function<void()> task);
+
+    /**
+     * @brief Blocks until every task that has been added has finished
+     */
+    void wait();
+
+    unsigned getThreadCount() const;
+
+  private:
+    void workerLoop();
+
+    std::vector<std::thread> m_threads;
+    std::queue<std::function<void()>> m_tasks;
+
+    std::mutex m_mutex;
+    std::condition_variable m_taskAdded;
+    std::condition_variable m_tasksFinished;
+
+    unsigned m_unfinishedTasks = 0;
+    bool m_isStopping = false;
+};
@@ -0,0 +1,71 @@
+#include "utf8.h"
+
+namespace {
+constexpr char32_t REPLACEMENT_CHARACTER = 0xFFFD;
+
+bool isContinuation(unsigned char byte)
+{
+    return (byte & 0xC0) == 0x80;
+}
+} // namespace
+
+std::u32string decodeUtf8(const std::string &string)
+{
+    std::u32string codepoints;
+    codepoints.reserve(string.size());
+
+    std::size_t i = 0;
+    while (i < string.size()) {
+        auto lead = static_cast<unsigned char>(string[i]);
+        if (lead < 0x80) {
+            codepoints.push_back(lead);
+            i++;
+            continue;
+        }
+
+        // The lead byte gives the length of the sequence, and the bits of the
+        // codepoint that it holds
+        std::size_t length = 0;
+        char32_t codepoint = 0;
+        char32_t minimum = 0;
+        if ((lead & 0xE0) == 0xC0) {
+            length = 2;
+            codepoint = lead & 0x1F;
+            minimum = 0x80;
+        }
+        else if ((lead & 0xF0) == 0xE0) {
+            length = 3;
+            codepoint = lead & 0x0F;
+            minimum = 0x800;
+        }
+        else if ((lead & 0xF8) == 0xF0) {
+            length = 4;
+            codepoint = lead & 0x07;
+            minimum = 0x10000;
+        }
+        else {
+            codepoints.push_back(REPLACEMENT_CHARACTER);
+            i++;
+            continue;
+        }
+
+        std::size_t read = 1;
+        while (read < length && i + read < string.size() &&
+               isContinuation(static_cast<unsigned char>(string[i + read]))) {
+            codepoint = (codepoint << 6) |
+                        (static_cast<unsigned char>(string[i + read]) & 0x3F);
+            read++;
+        }
+        i += read;
+
+        // Truncated, overlong and surrogate encodings are all rejected
+        if (read < length || codepoint < minimum || codepoint > 0x10FFFF ||
+            (codepoint >= 0xD800 && codepoint <= 0xDFFF)) {
+            codepoints.push_back(REPLACEMENT_CHARACTER);
+        }
+        else {
+            codepoints.push_back(codepoint);
+        }
+    }
+    return codepoints;
+}
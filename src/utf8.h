@@ -0,0 +1,12 @@
+#pragma once
+
+#include <string>
+
+/**
+ * @brief Decodes a UTF-8 string into unicode codepoints
+ *
+ * @param string The UTF-8 encoded string
+ * @return std::u32string One codepoint per character. Malformed sequences
+ * become U+FFFD, the replacement character
+ */
+std::u32string decodeUtf8(const std::string &string);